@@ -0,0 +1,48 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "BatchDecrypt.h"
+
+namespace CDMi {
+
+// Implemented by the WideVine sessions, reachable through a dynamic_cast of
+// the IMediaKeySession instance, like IBatchDecrypt. Samples are described
+// the same way, the result is reported through the callback instead.
+struct IAsyncDecrypt {
+  struct IDecryptCallback {
+    virtual ~IDecryptCallback() {}
+
+    // Invoked on the session worker thread once a queued sample is done.
+    virtual void Decrypted(const IBatchDecrypt::Sample& sample) = 0;
+  };
+
+  virtual ~IAsyncDecrypt() {}
+
+  // DecryptAsync queues the sample to the session worker and returns
+  // immediately. The sample buffers must stay valid until the callback
+  // reported it, a single thread may queue. DisableAsync returns once the
+  // samples still queued have been reported as failed.
+  virtual CDMi_RESULT EnableAsync(IDecryptCallback* callback) = 0;
+  virtual void DisableAsync() = 0;
+  virtual CDMi_RESULT DecryptAsync(const IBatchDecrypt::Sample& sample) = 0;
+};
+
+}  // namespace CDMi
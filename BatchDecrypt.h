@@ -0,0 +1,62 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cdmi.h>
+
+#include <nexus_memory.h>
+
+#include <stdint.h>
+#include <vector>
+
+namespace CDMi {
+
+// Implemented by the WideVine sessions, reachable through a dynamic_cast of
+// the IMediaKeySession instance CreateMediaKeySession hands out. A server
+// that finds it can pass a whole fragment at once, others keep calling
+// Decrypt per sample.
+struct IBatchDecrypt {
+  // The secure output token is returned in token instead of being written
+  // over data, as Decrypt does. Audio sessions decrypt data in place and
+  // return no token.
+  struct Sample {
+    const uint8_t* data;
+    uint32_t length;
+    const uint8_t* iv;
+    uint32_t ivLength;
+    const uint32_t* subSampleMapping;
+    uint32_t subSampleMappingCount;
+    const uint8_t* keyId;
+    uint8_t keyIdLength;
+    NEXUS_MemoryBlockTokenHandle token;
+    // Start of the output in the block behind token, see SecureSlab.
+    uint32_t offset;
+    CDMi_RESULT result;
+  };
+
+  virtual ~IBatchDecrypt() {}
+
+  // Decrypts all samples under a single lock, CDMi_SUCCESS only if every
+  // sample succeeded. Tokens are returned through ReleaseClearContent like
+  // the ones produced by Decrypt.
+  virtual CDMi_RESULT DecryptBatch(std::vector<Sample>& samples) = 0;
+};
+
+}  // namespace CDMi
@@ -0,0 +1,105 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CdmInstance.h"
+#include "KeyStatusNotifier.h"
+#include "SessionRegistry.h"
+
+#include <core/core.h>
+
+namespace CDMi {
+
+CdmInstance::CdmInstance(SessionRegistry& sessions, KeyStatusNotifier& notifier)
+  : _registry(sessions)
+  , _notifier(notifier)
+  , _lock()
+  , _cdm(nullptr)
+  , _keys()
+  , _pool()
+  , _cache()
+  , _sessions(0) {
+}
+
+CdmInstance::~CdmInstance() {
+  Close();
+}
+
+bool CdmInstance::Open(widevine::Cdm::IStorage& storage) {
+  // Setting the last parameter to true, requres serviceCertificates so the
+  // requests can be encrypted. Currently badly supported in the EME tests,
+  // so turn of for now :-)
+  _cdm = widevine::Cdm::create(this, &storage, false);
+  return (_cdm != nullptr);
+}
+
+void CdmInstance::Close() {
+  if (_cdm != nullptr) {
+    _pool.Stop();
+    _cache.Clear();
+
+    TRACE_L1(_T("CDM lock contended %u of %u times"), _lock.Contentions(), _lock.Acquisitions());
+    TRACE_L1(_T("Session pool served %u sessions, %u missed"), _pool.Hits(), _pool.Misses());
+    TRACE_L1(_T("License cache restored %u sessions, %u missed"), _cache.Hits(), _cache.Misses());
+
+    delete _cdm;
+    _cdm = nullptr;
+  }
+}
+
+void CdmInstance::onMessage(const std::string& session_id, widevine::Cdm::MessageType f_messageType,
+    const std::string& f_message) {
+  _registry.Dispatch(session_id, [&](MediaKeySession& session) {
+    session.onMessage(f_messageType, f_message);
+  });
+}
+
+#if defined (USE_CENC14) || defined (USE_CENC15)
+void CdmInstance::onKeyStatusesChange(const std::string& session_id, bool /* has_new_usable_key */)
+#else
+void CdmInstance::onKeyStatusesChange(const std::string& session_id)
+#endif
+{
+  _registry.Dispatch(session_id, [](MediaKeySession& session) {
+    session.onKeyStatusChange();
+  });
+  _notifier.Schedule(session_id);
+}
+
+void CdmInstance::onRemoveComplete(const std::string& session_id) {
+  _registry.Dispatch(session_id, [](MediaKeySession& session) {
+    session.onRemoveComplete();
+  });
+  _notifier.Schedule(session_id);
+}
+
+// Called when a deferred action has completed.
+void CdmInstance::onDeferredComplete(const std::string& session_id, widevine::Cdm::Status result) {
+  _registry.Dispatch(session_id, [result](MediaKeySession& session) {
+    session.onDeferredComplete(result);
+  });
+}
+
+// Called when the CDM requires a new device certificate
+void CdmInstance::onDirectIndividualizationRequest(const std::string& session_id, const std::string& request) {
+  _registry.Dispatch(session_id, [&](MediaKeySession& session) {
+    session.onDirectIndividualizationRequest(session_id, request);
+  });
+}
+
+}  // namespace CDMi
@@ -0,0 +1,107 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "CountingLock.h"
+#include "KeyTable.h"
+#include "LicenseCache.h"
+#include "SessionPool.h"
+
+#include <cdm.h>
+
+#include <atomic>
+#include <string>
+
+namespace CDMi {
+
+class KeyStatusNotifier;
+class SessionRegistry;
+
+// One widevine::Cdm and everything bound to it: the lock around its license
+// state changes, the keys its sessions share, the sessions prepared ahead and
+// the licenses parked on it. A Cdm serializes its sessions internally, so the
+// system spreads them over a few instances. Each instance is the event
+// listener of its own Cdm and dispatches the events to its sessions.
+class CdmInstance : public widevine::Cdm::IEventListener {
+public:
+  CdmInstance(const CdmInstance&) = delete;
+  CdmInstance& operator=(const CdmInstance&) = delete;
+
+  CdmInstance(SessionRegistry& sessions, KeyStatusNotifier& notifier);
+  ~CdmInstance() override;
+
+public:
+  // Widevine::Cdm::initialize must have succeeded.
+  bool Open(widevine::Cdm::IStorage& storage);
+  // The sessions must be gone, parked ones are closed here.
+  void Close();
+
+  inline widevine::Cdm* Cdm() {
+    return (_cdm);
+  }
+  inline CountingLock& Lock() {
+    return (_lock);
+  }
+  inline KeyDirectory& Keys() {
+    return (_keys);
+  }
+  inline SessionPool& Pool() {
+    return (_pool);
+  }
+  inline LicenseCache& Cache() {
+    return (_cache);
+  }
+
+  // Live client sessions, the load sessions are assigned by.
+  inline uint32_t Sessions() const {
+    return (_sessions.load(std::memory_order_relaxed));
+  }
+  inline void AddSession() {
+    _sessions.fetch_add(1, std::memory_order_relaxed);
+  }
+  inline void RemoveSession() {
+    _sessions.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  // widevine::Cdm::IEventListener
+  void onMessage(const std::string& session_id, widevine::Cdm::MessageType f_messageType,
+      const std::string& f_message) override;
+#if defined (USE_CENC14) || defined (USE_CENC15)
+  void onKeyStatusesChange(const std::string& session_id, bool has_new_usable_key) override;
+#else
+  void onKeyStatusesChange(const std::string& session_id) override;
+#endif
+  void onRemoveComplete(const std::string& session_id) override;
+  void onDeferredComplete(const std::string& session_id, widevine::Cdm::Status result) override;
+  virtual void onDirectIndividualizationRequest(const std::string& session_id, const std::string& request);
+
+private:
+  SessionRegistry& _registry;
+  KeyStatusNotifier& _notifier;
+  CountingLock _lock;
+  widevine::Cdm* _cdm;
+  // Usable keys of the sessions on _cdm, outlives them.
+  KeyDirectory _keys;
+  SessionPool _pool;
+  LicenseCache _cache;
+  std::atomic<uint32_t> _sessions;
+};
+
+}  // namespace CDMi
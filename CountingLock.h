@@ -0,0 +1,66 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+namespace CDMi {
+
+// Recursive lock that keeps track of how often a caller had to wait for it,
+// so the effect of splitting locks can be measured on the target.
+class CountingLock {
+public:
+  CountingLock(const CountingLock&) = delete;
+  CountingLock& operator=(const CountingLock&) = delete;
+
+  CountingLock()
+    : _lock()
+    , _acquisitions(0)
+    , _contentions(0) {
+  }
+  ~CountingLock() {
+  }
+
+public:
+  inline void Lock() {
+    if (_lock.try_lock() == false) {
+      _contentions.fetch_add(1, std::memory_order_relaxed);
+      _lock.lock();
+    }
+    _acquisitions.fetch_add(1, std::memory_order_relaxed);
+  }
+  inline void Unlock() {
+    _lock.unlock();
+  }
+  inline uint32_t Acquisitions() const {
+    return (_acquisitions.load(std::memory_order_relaxed));
+  }
+  inline uint32_t Contentions() const {
+    return (_contentions.load(std::memory_order_relaxed));
+  }
+
+private:
+  std::recursive_mutex _lock;
+  std::atomic<uint32_t> _acquisitions;
+  std::atomic<uint32_t> _contentions;
+};
+
+}  // namespace CDMi
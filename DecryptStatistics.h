@@ -0,0 +1,440 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cdm.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include <string>
+
+namespace CDMi {
+
+// Point in time view of the decrypt path, all latencies in nanoseconds.
+struct DecryptStatistics {
+  enum Stage : uint8_t {
+    STAGE_LOCK_WAIT,  // waiting for the session decrypt lock
+    STAGE_ALLOCATION, // getting a secure output block
+    STAGE_COPY,       // staging heap input into Nexus memory
+    STAGE_DECRYPT,    // widevine::Cdm::decrypt, all ranges of a sample
+    STAGE_SAMPLE,     // whole sample once the lock is held
+    STAGE_KEY_ROTATION, // a key waited for until it became usable, per key
+    STAGE_BACKPRESSURE, // waiting for the consumer to release a secure token
+    STAGE_SECURE_COPY_WAIT, // clear ranges still moving by DMA after the CDM is done
+    STAGE_COUNT
+  };
+
+  enum Failure : uint8_t {
+    FAILURE_KEY_NOT_USABLE,
+    FAILURE_SECURE_MEMORY,
+    FAILURE_INPUT_MEMORY,
+    FAILURE_SUBSAMPLE_MAPPING,
+    FAILURE_SECURE_COPY,
+    // Reported by widevine::Cdm::decrypt.
+    FAILURE_CDM_DECRYPT_ERROR,
+    FAILURE_CDM_NO_KEY,
+    FAILURE_CDM_SESSION_NOT_FOUND,
+    FAILURE_CDM_NEEDS_DEVICE_CERTIFICATE,
+    FAILURE_CDM_INVALID_STATE,
+    FAILURE_CDM_NOT_SUPPORTED,
+    FAILURE_CDM_OTHER,
+    FAILURE_COUNT
+  };
+
+  struct Latency {
+    uint64_t count;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+  };
+
+  static const char* StageName(Stage stage) {
+    switch (stage) {
+    case STAGE_LOCK_WAIT:
+      return "lock-wait";
+    case STAGE_ALLOCATION:
+      return "allocation";
+    case STAGE_COPY:
+      return "copy";
+    case STAGE_DECRYPT:
+      return "decrypt";
+    case STAGE_SAMPLE:
+      return "sample";
+    case STAGE_KEY_ROTATION:
+      return "key-rotation";
+    case STAGE_BACKPRESSURE:
+      return "backpressure";
+    case STAGE_SECURE_COPY_WAIT:
+      return "dma-wait";
+    default:
+      return "unknown";
+    }
+  }
+
+  static const char* FailureName(Failure failure) {
+    switch (failure) {
+    case FAILURE_KEY_NOT_USABLE:
+      return "KeyNotUsable";
+    case FAILURE_SECURE_MEMORY:
+      return "SecureMemory";
+    case FAILURE_INPUT_MEMORY:
+      return "InputMemory";
+    case FAILURE_SUBSAMPLE_MAPPING:
+      return "SubsampleMapping";
+    case FAILURE_SECURE_COPY:
+      return "SecureCopy";
+    case FAILURE_CDM_DECRYPT_ERROR:
+      return "DecryptError";
+    case FAILURE_CDM_NO_KEY:
+      return "NoKey";
+    case FAILURE_CDM_SESSION_NOT_FOUND:
+      return "SessionNotFound";
+    case FAILURE_CDM_NEEDS_DEVICE_CERTIFICATE:
+      return "NeedsDeviceCertificate";
+    case FAILURE_CDM_INVALID_STATE:
+      return "InvalidState";
+    case FAILURE_CDM_NOT_SUPPORTED:
+      return "NotSupported";
+    default:
+      return "UnExpectedError";
+    }
+  }
+
+  uint64_t samples;
+  uint64_t bytes;
+  uint64_t zeroCopySamples;
+  uint64_t routedSamples; // key held by another session on the same CDM
+  uint64_t secureAllocations;
+  uint64_t abandonedTokens; // never released by the consumer, dropped
+  uint64_t secureCopyBytes; // clear bytes moved by DMA instead of the CDM
+  // Sub-allocation of secure memory, see SecureSlab. The fragmentation is in
+  // the gap between allocated and requested bytes (size classes) and in the
+  // number of free regions the remainder is split into.
+  uint64_t slabReserved;    // bytes held right now
+  uint64_t slabAllocated;   // of those handed out right now
+  uint64_t slabRequested;   // of those the samples asked for
+  uint64_t slabFreeRegions; // free regions right now
+  uint64_t slabFallbacks;   // samples that needed a block of their own
+  uint64_t inputGrows;
+  uint64_t inputShrinks;
+  uint64_t inputCapacity; // bytes of input staging memory held right now
+  uint64_t failures[FAILURE_COUNT];
+  Latency latencies[STAGE_COUNT];
+};
+
+// Implemented by the WideVine system, reachable through a dynamic_cast of
+// the IMediaKeys instance.
+struct IDecryptStatistics {
+  virtual ~IDecryptStatistics() {}
+
+  // All sessions, including the ones already destroyed.
+  virtual void Statistics(DecryptStatistics& statistics) const = 0;
+
+  // A single live session, false if the session id is unknown.
+  virtual bool Statistics(const std::string& sessionId, DecryptStatistics& statistics) const = 0;
+};
+
+// Log-linear histogram in the spirit of HdrHistogram: every power of two is
+// split in 16 buckets, so any value is kept within ~6%. Recording is a single
+// relaxed increment, values beyond ~18 minutes land in the last bucket.
+class LatencyHistogram {
+private:
+  static constexpr uint8_t SubBucketBits = 4;
+  static constexpr uint32_t SubBuckets = (1 << SubBucketBits);
+  static constexpr uint8_t MaximumShift = 36;
+  static constexpr uint32_t BucketCount = (MaximumShift + 2) * SubBuckets;
+
+public:
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+  LatencyHistogram()
+    : _count(0)
+    , _max(0) {
+    for (std::atomic<uint32_t>& bucket : _buckets) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+  }
+  ~LatencyHistogram() {
+  }
+
+public:
+  inline void Record(uint64_t value) {
+    _buckets[Index(value)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = _max.load(std::memory_order_relaxed);
+    while ((value > max) && (_max.compare_exchange_weak(max, value, std::memory_order_relaxed) == false)) {
+    }
+  }
+
+  void Add(const LatencyHistogram& other) {
+    for (uint32_t index = 0; index < BucketCount; index++) {
+      const uint32_t count = other._buckets[index].load(std::memory_order_relaxed);
+      if (count != 0) {
+        _buckets[index].fetch_add(count, std::memory_order_relaxed);
+      }
+    }
+    _count.fetch_add(other._count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+    const uint64_t value = other._max.load(std::memory_order_relaxed);
+    uint64_t max = _max.load(std::memory_order_relaxed);
+    while ((value > max) && (_max.compare_exchange_weak(max, value, std::memory_order_relaxed) == false)) {
+    }
+  }
+
+  void Get(DecryptStatistics::Latency& latency) const {
+    latency.count = _count.load(std::memory_order_relaxed);
+    latency.max = _max.load(std::memory_order_relaxed);
+    latency.p50 = Percentile(latency.count, 500, latency.max);
+    latency.p90 = Percentile(latency.count, 900, latency.max);
+    latency.p99 = Percentile(latency.count, 990, latency.max);
+    latency.p999 = Percentile(latency.count, 999, latency.max);
+  }
+
+private:
+  static inline uint32_t Index(uint64_t value) {
+    if (value < SubBuckets) {
+      return (static_cast<uint32_t>(value));
+    }
+
+    const uint8_t shift = 63 - static_cast<uint8_t>(__builtin_clzll(value)) - SubBucketBits;
+    if (shift > MaximumShift) {
+      return (BucketCount - 1);
+    }
+    return (((shift + 1) * SubBuckets) + static_cast<uint32_t>((value >> shift) - SubBuckets));
+  }
+
+  // Highest value that maps onto the bucket.
+  static inline uint64_t UpperBound(uint32_t index) {
+    if (index < SubBuckets) {
+      return (index);
+    }
+
+    const uint8_t shift = static_cast<uint8_t>((index / SubBuckets) - 1);
+    const uint64_t lower = static_cast<uint64_t>(SubBuckets + (index % SubBuckets)) << shift;
+    return (lower + (static_cast<uint64_t>(1) << shift) - 1);
+  }
+
+  // permille of the recorded values are at or below the returned value.
+  uint64_t Percentile(uint64_t count, uint32_t permille, uint64_t max) const {
+    const uint64_t rank = ((count * permille) + 999) / 1000;
+    uint64_t seen = 0;
+
+    for (uint32_t index = 0; (index < BucketCount) && (rank != 0); index++) {
+      seen += _buckets[index].load(std::memory_order_relaxed);
+      if (seen >= rank) {
+        const uint64_t bound = UpperBound(index);
+        return (bound < max ? bound : max);
+      }
+    }
+    return (0);
+  }
+
+private:
+  std::atomic<uint32_t> _buckets[BucketCount];
+  std::atomic<uint64_t> _count;
+  std::atomic<uint64_t> _max;
+};
+
+// Lock-free counters and histograms of one session (or the sum of several).
+class DecryptMetrics {
+public:
+  DecryptMetrics(const DecryptMetrics&) = delete;
+  DecryptMetrics& operator=(const DecryptMetrics&) = delete;
+
+  DecryptMetrics()
+    : _samples(0)
+    , _bytes(0)
+    , _zeroCopySamples(0)
+    , _routedSamples(0)
+    , _secureAllocations(0)
+    , _abandonedTokens(0)
+    , _secureCopyBytes(0)
+    , _slabReserved(0)
+    , _slabAllocated(0)
+    , _slabRequested(0)
+    , _slabFreeRegions(0)
+    , _slabFallbacks(0)
+    , _inputGrows(0)
+    , _inputShrinks(0)
+    , _inputCapacity(0) {
+    for (std::atomic<uint32_t>& failure : _failures) {
+      failure.store(0, std::memory_order_relaxed);
+    }
+  }
+  ~DecryptMetrics() {
+  }
+
+public:
+  static inline uint64_t Now() {
+    return (static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count()));
+  }
+
+  static DecryptStatistics::Failure FailureOf(widevine::Cdm::Status status) {
+    switch (status) {
+    case widevine::Cdm::kDecryptError:
+      return (DecryptStatistics::FAILURE_CDM_DECRYPT_ERROR);
+    case widevine::Cdm::kNoKey:
+      return (DecryptStatistics::FAILURE_CDM_NO_KEY);
+    case widevine::Cdm::kSessionNotFound:
+      return (DecryptStatistics::FAILURE_CDM_SESSION_NOT_FOUND);
+    case widevine::Cdm::kNeedsDeviceCertificate:
+      return (DecryptStatistics::FAILURE_CDM_NEEDS_DEVICE_CERTIFICATE);
+    case widevine::Cdm::kInvalidState:
+      return (DecryptStatistics::FAILURE_CDM_INVALID_STATE);
+    case widevine::Cdm::kNotSupported:
+      return (DecryptStatistics::FAILURE_CDM_NOT_SUPPORTED);
+    default:
+      return (DecryptStatistics::FAILURE_CDM_OTHER);
+    }
+  }
+
+  inline void Record(DecryptStatistics::Stage stage, uint64_t nanoseconds) {
+    _latencies[stage].Record(nanoseconds);
+  }
+  inline void Decrypted(uint32_t bytes) {
+    _samples.fetch_add(1, std::memory_order_relaxed);
+    _bytes.fetch_add(bytes, std::memory_order_relaxed);
+  }
+  inline void ZeroCopy() {
+    _zeroCopySamples.fetch_add(1, std::memory_order_relaxed);
+  }
+  inline void Routed() {
+    _routedSamples.fetch_add(1, std::memory_order_relaxed);
+  }
+  inline void SecureAllocation() {
+    _secureAllocations.fetch_add(1, std::memory_order_relaxed);
+  }
+  inline void Abandoned() {
+    _abandonedTokens.fetch_add(1, std::memory_order_relaxed);
+  }
+  inline void SecureCopied(uint32_t bytes) {
+    _secureCopyBytes.fetch_add(bytes, std::memory_order_relaxed);
+  }
+  inline void SlabReserved(uint64_t bytes) {
+    _slabReserved.fetch_add(bytes, std::memory_order_relaxed);
+  }
+  inline void SlabAllocated(uint32_t capacity, uint32_t requested) {
+    _slabAllocated.fetch_add(capacity, std::memory_order_relaxed);
+    _slabRequested.fetch_add(requested, std::memory_order_relaxed);
+  }
+  inline void SlabFreed(uint32_t capacity, uint32_t requested) {
+    _slabAllocated.fetch_sub(capacity, std::memory_order_relaxed);
+    _slabRequested.fetch_sub(requested, std::memory_order_relaxed);
+  }
+  inline void SlabFragments(int32_t delta) {
+    _slabFreeRegions.fetch_add(static_cast<uint64_t>(static_cast<int64_t>(delta)), std::memory_order_relaxed);
+  }
+  inline void SlabFallback() {
+    _slabFallbacks.fetch_add(1, std::memory_order_relaxed);
+  }
+  inline void InputResized(uint32_t from, uint32_t to) {
+    if (to > from) {
+      _inputGrows.fetch_add(1, std::memory_order_relaxed);
+      _inputCapacity.fetch_add(to - from, std::memory_order_relaxed);
+    } else {
+      _inputShrinks.fetch_add(1, std::memory_order_relaxed);
+      _inputCapacity.fetch_sub(from - to, std::memory_order_relaxed);
+    }
+  }
+  inline void Failed(DecryptStatistics::Failure failure) {
+    _failures[failure].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Everything but what the session still holds, for sessions that are gone.
+  void Retire(const DecryptMetrics& other) {
+    _samples.fetch_add(other._samples.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    _bytes.fetch_add(other._bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    _zeroCopySamples.fetch_add(other._zeroCopySamples.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    _routedSamples.fetch_add(other._routedSamples.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    _secureAllocations.fetch_add(other._secureAllocations.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    _abandonedTokens.fetch_add(other._abandonedTokens.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    _secureCopyBytes.fetch_add(other._secureCopyBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    _slabFallbacks.fetch_add(other._slabFallbacks.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    for (uint8_t index = 0; index < DecryptStatistics::FAILURE_COUNT; index++) {
+      _failures[index].fetch_add(other._failures[index].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    _inputGrows.fetch_add(other._inputGrows.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    _inputShrinks.fetch_add(other._inputShrinks.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    for (uint8_t index = 0; index < DecryptStatistics::STAGE_COUNT; index++) {
+      _latencies[index].Add(other._latencies[index]);
+    }
+  }
+
+  void Add(const DecryptMetrics& other) {
+    Retire(other);
+    _inputCapacity.fetch_add(other._inputCapacity.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    _slabReserved.fetch_add(other._slabReserved.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    _slabAllocated.fetch_add(other._slabAllocated.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    _slabRequested.fetch_add(other._slabRequested.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    _slabFreeRegions.fetch_add(other._slabFreeRegions.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  }
+
+  void Get(DecryptStatistics& statistics) const {
+    statistics.samples = _samples.load(std::memory_order_relaxed);
+    statistics.bytes = _bytes.load(std::memory_order_relaxed);
+    statistics.zeroCopySamples = _zeroCopySamples.load(std::memory_order_relaxed);
+    statistics.routedSamples = _routedSamples.load(std::memory_order_relaxed);
+    statistics.secureAllocations = _secureAllocations.load(std::memory_order_relaxed);
+    statistics.abandonedTokens = _abandonedTokens.load(std::memory_order_relaxed);
+    statistics.secureCopyBytes = _secureCopyBytes.load(std::memory_order_relaxed);
+    statistics.slabReserved = _slabReserved.load(std::memory_order_relaxed);
+    statistics.slabAllocated = _slabAllocated.load(std::memory_order_relaxed);
+    statistics.slabRequested = _slabRequested.load(std::memory_order_relaxed);
+    statistics.slabFreeRegions = _slabFreeRegions.load(std::memory_order_relaxed);
+    statistics.slabFallbacks = _slabFallbacks.load(std::memory_order_relaxed);
+    statistics.inputGrows = _inputGrows.load(std::memory_order_relaxed);
+    statistics.inputShrinks = _inputShrinks.load(std::memory_order_relaxed);
+    statistics.inputCapacity = _inputCapacity.load(std::memory_order_relaxed);
+    for (uint8_t index = 0; index < DecryptStatistics::FAILURE_COUNT; index++) {
+      statistics.failures[index] = _failures[index].load(std::memory_order_relaxed);
+    }
+    for (uint8_t index = 0; index < DecryptStatistics::STAGE_COUNT; index++) {
+      _latencies[index].Get(statistics.latencies[index]);
+    }
+  }
+
+private:
+  std::atomic<uint64_t> _samples;
+  std::atomic<uint64_t> _bytes;
+  std::atomic<uint64_t> _zeroCopySamples;
+  std::atomic<uint64_t> _routedSamples;
+  std::atomic<uint64_t> _secureAllocations;
+  std::atomic<uint64_t> _abandonedTokens;
+  std::atomic<uint64_t> _secureCopyBytes;
+  std::atomic<uint64_t> _slabReserved;
+  std::atomic<uint64_t> _slabAllocated;
+  std::atomic<uint64_t> _slabRequested;
+  std::atomic<uint64_t> _slabFreeRegions;
+  std::atomic<uint64_t> _slabFallbacks;
+  std::atomic<uint64_t> _inputGrows;
+  std::atomic<uint64_t> _inputShrinks;
+  std::atomic<uint64_t> _inputCapacity;
+  std::atomic<uint32_t> _failures[DecryptStatistics::FAILURE_COUNT];
+  LatencyHistogram _latencies[DecryptStatistics::STAGE_COUNT];
+};
+
+}  // namespace CDMi
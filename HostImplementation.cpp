@@ -19,71 +19,408 @@
 
 #include "HostImplementation.h"
 
+#include <algorithm>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 using namespace widevine;
 using namespace WPEFramework;
 
 namespace CDMi {
 
+constexpr uint32_t HostImplementation::WriteBehindDelayMs;
+
+// EncodeName only ever emits '%' followed by two hex digits, so no CDM file
+// can start with this.
+static const char TemporaryPrefix[] = "%tmp.";
+static const char ContainerName[] = "cdm.store";
+
+// CDM file names are flat, but make sure nothing can escape the directory.
+static std::string EncodeName(const std::string& name) {
+  static const char hex[] = "0123456789ABCDEF";
+  std::string result;
+  for (const char c : name) {
+    if ((c == '/') || (c == '%')) {
+      result += '%';
+      result += hex[(c >> 4) & 0x0F];
+      result += hex[c & 0x0F];
+    } else {
+      result += c;
+    }
+  }
+  return (result);
+}
+
+static int HexValue(const char c) {
+  if ((c >= '0') && (c <= '9')) {
+    return (c - '0');
+  }
+  if ((c >= 'A') && (c <= 'F')) {
+    return (c - 'A' + 10);
+  }
+  if ((c >= 'a') && (c <= 'f')) {
+    return (c - 'a' + 10);
+  }
+  return (-1);
+}
+
+// Anything that is not a valid escape is taken over as is.
+static std::string DecodeName(const std::string& name) {
+  std::string result;
+  for (std::string::size_type index = 0; index < name.size(); index++) {
+    const int high = ((name[index] == '%') && ((index + 2) < name.size()) ? HexValue(name[index + 1]) : -1);
+    const int low = (high >= 0 ? HexValue(name[index + 2]) : -1);
+    if (low >= 0) {
+      result += static_cast<char>((high << 4) | low);
+      index += 2;
+    } else {
+      result += name[index];
+    }
+  }
+  return (result);
+}
+
+static bool WriteFully(int fd, const std::string& data) {
+  const char* buffer = data.data();
+  size_t remaining = data.size();
+  while (remaining > 0) {
+    ssize_t written = ::write(fd, buffer, remaining);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return (false);
+    }
+    buffer += written;
+    remaining -= written;
+  }
+  return (true);
+}
+
+static bool ReadFully(const std::string& path, std::string& data) {
+  bool result = false;
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    struct stat info;
+    if (::fstat(fd, &info) == 0) {
+      data.resize(info.st_size);
+      size_t offset = 0;
+      while (offset < data.size()) {
+        ssize_t count = ::read(fd, &data[offset], data.size() - offset);
+        if ((count < 0) && (errno == EINTR)) {
+          continue;
+        }
+        if (count <= 0) {
+          break;
+        }
+        offset += count;
+      }
+      result = (offset == data.size());
+    }
+    ::close(fd);
+  }
+  return (result);
+}
+
 HostImplementation::HostImplementation()
   : widevine::Cdm::IStorage()
   , widevine::Cdm::IClock()
   , widevine::Cdm::ITimer()
   , _timer(Core::Thread::DefaultStackSize(),  _T("widevine"))
-  , _files() {
+  , _adminLock()
+  , _files()
+  , _container()
+  , _storagePath()
+  , _pending()
+  , _pendingLock()
+  , _pendingSignal()
+  , _writer()
+  , _running(false) {
 }
 
 HostImplementation::~HostImplementation() {
+  if (_writer.joinable() == true) {
+    {
+      std::lock_guard<std::mutex> guard(_pendingLock);
+      _running = false;
+    }
+    _pendingSignal.notify_one();
+    _writer.join();
+  }
 }
 
 void HostImplementation::PreloadFile(const std::string& filename, string&& filecontent ) {
-  _files.emplace(filename, filecontent);
+  _adminLock.Lock();
+  _files[filename] = std::move(filecontent);
+  _adminLock.Unlock();
+}
+
+bool HostImplementation::Initialize(const std::string& storagePath, const bool container) {
+  ASSERT((_writer.joinable() == false) && (_container.IsOpen() == false));
+
+  if ((::mkdir(storagePath.c_str(), 0700) != 0) && (errno != EEXIST)) {
+    TRACE_L1("Could not create storage %s: %d", storagePath.c_str(), errno);
+    return (false);
+  }
+
+  _storagePath = storagePath;
+  if (_storagePath.back() != '/') {
+    _storagePath += '/';
+  }
+
+  if (container == true) {
+    return ((_container.Open(_storagePath + ContainerName) == true) && (Import() == true));
+  }
+
+  StorageMap files;
+  Load(files);
+
+  _adminLock.Lock();
+  for (auto& entry : files) {
+    _files[DecodeName(entry.first)] = std::move(entry.second);
+  }
+  _adminLock.Unlock();
+
+  _running = true;
+  _writer = std::thread(&HostImplementation::WriteBehind, this);
+
+  return (true);
+}
+
+std::string HostImplementation::PathOf(const std::string& name) const {
+  return (_storagePath + EncodeName(name));
 }
+
+// Reads the directory store, keyed by the file names as found on disk.
+void HostImplementation::Load(StorageMap& files) {
+  DIR* directory = ::opendir(_storagePath.c_str());
+
+  if (directory != nullptr) {
+    const size_t prefixLength = sizeof(TemporaryPrefix) - 1;
+    struct dirent* entry;
+
+    while ((entry = ::readdir(directory)) != nullptr) {
+      const std::string file(entry->d_name);
+
+      if ((file == ".") || (file == "..") || (file.compare(0, sizeof(ContainerName) - 1, ContainerName) == 0)) {
+        continue;
+      }
+      if (file.compare(0, prefixLength, TemporaryPrefix) == 0) {
+        // Leftover of a write that never got renamed, the previous version is intact.
+        ::unlink((_storagePath + file).c_str());
+        continue;
+      }
+
+      std::string data;
+      if (ReadFully(_storagePath + file, data) == true) {
+        files[file] = std::move(data);
+      }
+    }
+    ::closedir(directory);
+  }
+}
+
+// Moves what an earlier directory store left behind into the container. The
+// container is newer, so names it already has are not overwritten. Files are
+// only removed once a reopen shows the container has them on disk.
+bool HostImplementation::Import() {
+  StorageMap files;
+  Load(files);
+
+  if (files.empty() == true) {
+    return (true);
+  }
+
+  for (const auto& entry : files) {
+    const std::string name(DecodeName(entry.first));
+    if (_container.Exists(name) == false) {
+      _container.Write(name, entry.second);
+    }
+  }
+
+  // Closing drains the writer.
+  _container.Close();
+  if (_container.Open(_storagePath + ContainerName) == false) {
+    return (false);
+  }
+
+  uint32_t imported = 0;
+  for (const auto& entry : files) {
+    if (_container.Exists(DecodeName(entry.first)) == true) {
+      ::unlink((_storagePath + entry.first).c_str());
+      imported++;
+    }
+  }
+  TRACE_L1("Imported %u of %u files into the storage container", imported, static_cast<uint32_t>(files.size()));
+
+  return (true);
+}
+
+void HostImplementation::Schedule(const std::string& name, bool remove, const std::string& data) {
+  if (_writer.joinable() == true) {
+    {
+      std::lock_guard<std::mutex> guard(_pendingLock);
+      Pending& entry(_pending[name]);
+      entry.remove = remove;
+      entry.data = data;
+      // The writer is already collecting a batch, it picks this up with it.
+      if (_pending.size() == 1) {
+        _pendingSignal.notify_one();
+      }
+    }
+  }
+}
+
+// Write-behind worker: collects changes for a short while and commits them in
+// one go, so the CDM never waits for the flash.
+void HostImplementation::WriteBehind() {
+  std::unique_lock<std::mutex> guard(_pendingLock);
+
+  while ((_running == true) || (_pending.empty() == false)) {
+    if (_pending.empty() == true) {
+      _pendingSignal.wait(guard);
+      continue;
+    }
+
+    if (_running == true) {
+      const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(WriteBehindDelayMs);
+      _pendingSignal.wait_until(guard, deadline, [this]() { return (_running == false); });
+    }
+
+    PendingMap batch;
+    batch.swap(_pending);
+
+    guard.unlock();
+    Flush(batch);
+    guard.lock();
+  }
+}
+
+void HostImplementation::Flush(const PendingMap& batch) {
+  for (const auto& entry : batch) {
+    const std::string path(PathOf(entry.first));
+
+    if (entry.second.remove == true) {
+      ::unlink(path.c_str());
+    } else {
+      // Write aside and rename over the original, a power cut leaves either
+      // the old or the new version but never a torn file.
+      const std::string temporary(_storagePath + TemporaryPrefix + EncodeName(entry.first));
+      int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+      if (fd < 0) {
+        TRACE_L1("Could not create %s: %d", temporary.c_str(), errno);
+        continue;
+      }
+
+      bool written = WriteFully(fd, entry.second.data) && (::fsync(fd) == 0);
+      ::close(fd);
+
+      if ((written == false) || (::rename(temporary.c_str(), path.c_str()) != 0)) {
+        TRACE_L1("Could not store %s: %d", path.c_str(), errno);
+        ::unlink(temporary.c_str());
+      }
+    }
+  }
+
+  int directory = ::open(_storagePath.c_str(), O_RDONLY | O_DIRECTORY);
+  if (directory >= 0) {
+    ::fsync(directory);
+    ::close(directory);
+  }
+}
+
 // widevine::Cdm::IStorage implementation
 // ---------------------------------------------------------------------------
+// In container mode _files only holds what was preloaded from the
+// configuration, until the CDM replaces or removes it.
 /* virtual */ bool HostImplementation::read(const std::string& name, std::string* data) {
+  _adminLock.Lock();
   StorageMap::iterator it = _files.find(name);
   bool ok = it != _files.end();
+  if (ok) *data = it->second;
+  _adminLock.Unlock();
+  if (!ok && _container.IsOpen()) ok = _container.Read(name, data);
   TRACE_L1("read file: %s: %s", name.c_str(), ok ? "ok" : "fail");
-  if (!ok) return false;
-  *data = it->second;
-  return true;
+  return ok;
 }
 
 /* virtual */ bool HostImplementation::write(const std::string& name, const std::string& data) {
   TRACE_L1("write file: %s", name.c_str());
-  _files[name] = data;
+  // Queue the change while still holding the lock, as remove() does, so a
+  // concurrent write and remove of a name reach the flash in the same order
+  // as they were applied to _files.
+  _adminLock.Lock();
+  if (_container.IsOpen()) {
+    _files.erase(name);
+    _container.Write(name, data);
+  } else {
+    _files[name] = data;
+    Schedule(name, false, data);
+  }
+  _adminLock.Unlock();
   return true;
 }
 
 /* virtual */ bool HostImplementation::exists(const std::string& name) {
+  _adminLock.Lock();
   StorageMap::iterator it = _files.find(name);
   bool ok = it != _files.end();
+  _adminLock.Unlock();
+  if (!ok && _container.IsOpen()) ok = _container.Exists(name);
   TRACE_L1("exists? %s: %s", name.c_str(), ok ? "true" : "false");
   return ok;
 }
 
 /* virtual */ bool HostImplementation::remove(const std::string& name) {
   TRACE_L1("remove: %s", name.c_str());
+  _adminLock.Lock();
   if (name.empty()) {
     // If no name, delete all files (see DeviceFiles::DeleteAllFiles())
+    if (_container.IsOpen()) {
+      _container.RemoveAll();
+    } else {
+      for (StorageMap::iterator it = _files.begin(); it != _files.end(); it++) {
+        Schedule(it->first, true, std::string());
+      }
+    }
     _files.clear();
   } else {
     _files.erase(name);
+    if (_container.IsOpen()) {
+      _container.Remove(name);
+    } else {
+      Schedule(name, true, std::string());
+    }
   }
+  _adminLock.Unlock();
   return true;
 }
 
 /* virtual */ int32_t HostImplementation::size(const std::string& name) {
+  int32_t result = -1;
+  _adminLock.Lock();
   StorageMap::iterator it = _files.find(name);
-  if (it == _files.end()) return -1;
-  return it->second.size();
+  if (it != _files.end()) result = it->second.size();
+  _adminLock.Unlock();
+  if ((result < 0) && _container.IsOpen()) result = _container.Size(name);
+  return result;
 }
 
 /* virtual */ bool HostImplementation::list(std::vector<std::string>* names) {
   names->clear();
+  if (_container.IsOpen()) {
+    _container.List(names);
+  }
+  _adminLock.Lock();
   for (StorageMap::iterator it = _files.begin(); it != _files.end(); it++) {
+    if (std::find(names->begin(), names->end(), it->first) == names->end()) {
       names->push_back(it->first);
+    }
   }
+  _adminLock.Unlock();
   return true;
 }
 
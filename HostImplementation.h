@@ -21,9 +21,14 @@
 #define WIDEVINE_HOST_IMPLEMENTATION_H
 
 #include "cdm.h"
+#include "StorageContainer.h"
 
 #include <core/core.h>
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 namespace CDMi {
 
 class HostImplementation : 
@@ -35,6 +40,16 @@ private:
 
   typedef std::map<std::string, std::string> StorageMap;
 
+  // Changes not yet on flash, the last write or remove of a name wins.
+  struct Pending {
+    bool remove;
+    std::string data;
+  };
+  typedef std::map<std::string, Pending> PendingMap;
+
+  // Time the writer waits for more changes before it flushes a batch.
+  static constexpr uint32_t WriteBehindDelayMs = 100;
+
   class Timer {
   public:
     Timer() : _client(nullptr), _context(nullptr) {
@@ -80,6 +95,12 @@ public:
 
   void PreloadFile(const std::string& filename, string&& filecontent);
 
+  // Keeps the CDM files below storagePath, loading whatever is already there.
+  // Without it the files only live in memory for the lifetime of the plugin.
+  // With container set all files share one memory mapped file instead, files
+  // left by the directory store are moved into it on the first open.
+  bool Initialize(const std::string& storagePath, const bool container);
+
   // widevine::Cdm::IStorage implementation
   // ---------------------------------------------------------------------------
   bool read(const std::string& name, std::string* data) override;
@@ -98,9 +119,26 @@ public:
   void setTimeout(int64_t delay_ms, IClient* client, void* context) override;
   void cancel(IClient* client) override;
 
+private:
+  void Load(StorageMap& files);
+  bool Import();
+  void Schedule(const std::string& name, bool remove, const std::string& data);
+  void WriteBehind();
+  void Flush(const PendingMap& batch);
+  std::string PathOf(const std::string& name) const;
+
 private:
   WPEFramework::Core::TimerType<Timer> _timer;
+  WPEFramework::Core::CriticalSection _adminLock;
   StorageMap _files;
+  StorageContainer _container;
+
+  std::string _storagePath;
+  PendingMap _pending;
+  std::mutex _pendingLock;
+  std::condition_variable _pendingSignal;
+  std::thread _writer;
+  bool _running;
 };
 
 } // namespace CDMi
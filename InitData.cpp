@@ -0,0 +1,232 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "InitData.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace CDMi {
+
+static const uint8_t WidevineSystemId[] = {
+  0xED, 0xEF, 0x8B, 0xA9, 0x79, 0xD6, 0x4A, 0xCE,
+  0xA3, 0xC8, 0x27, 0xDC, 0xD5, 0x1D, 0x21, 0xED
+};
+
+// WidevinePsshData protobuf field numbers.
+static constexpr uint32_t FieldKeyId = 2;
+static constexpr uint32_t FieldTrackType = 5;
+static constexpr uint32_t FieldProtectionScheme = 9;
+
+static constexpr uint8_t WireVarint = 0;
+static constexpr uint8_t WireFixed64 = 1;
+static constexpr uint8_t WireLengthDelimited = 2;
+static constexpr uint8_t WireFixed32 = 5;
+
+static inline uint32_t FourCC(char a, char b, char c, char d) {
+  return ((static_cast<uint32_t>(a) << 24) | (static_cast<uint32_t>(b) << 16) |
+          (static_cast<uint32_t>(c) << 8) | static_cast<uint32_t>(d));
+}
+
+static inline uint32_t ReadBigEndian32(const uint8_t* data) {
+  return ((static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+          (static_cast<uint32_t>(data[2]) << 8) | static_cast<uint32_t>(data[3]));
+}
+
+static bool ReadVarint(const uint8_t*& data, const uint8_t* end, uint64_t& value) {
+  value = 0;
+  for (uint8_t shift = 0; (data < end) && (shift < 64); shift += 7) {
+    const uint8_t byte = *data++;
+    value |= (static_cast<uint64_t>(byte & 0x7F) << shift);
+    if ((byte & 0x80) == 0) {
+      return (true);
+    }
+  }
+  return (false);
+}
+
+InitData::InitData()
+  : _scheme(PROTECTION_CENC)
+  , _track(TRACK_UNKNOWN)
+  , _pattern(false)
+  , _cryptBlocks(0)
+  , _skipBlocks(0)
+  , _keyIds() {
+}
+
+InitData::~InitData() {
+}
+
+/* static */ const char* InitData::SchemeName(ProtectionScheme scheme) {
+  switch (scheme) {
+  case PROTECTION_CENC:
+    return "cenc";
+  case PROTECTION_CBC1:
+    return "cbc1";
+  case PROTECTION_CENS:
+    return "cens";
+  case PROTECTION_CBCS:
+    return "cbcs";
+  default:
+    return "unknown";
+  }
+}
+
+void InitData::Parse(widevine::Cdm::InitDataType type, const std::string& initData) {
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(initData.data());
+  const uint32_t length = static_cast<uint32_t>(initData.size());
+
+  _scheme = PROTECTION_CENC;
+  _track = TRACK_UNKNOWN;
+  _pattern = false;
+  _cryptBlocks = 0;
+  _skipBlocks = 0;
+  _keyIds.clear();
+
+  if (type == widevine::Cdm::kWebM) {
+    AddKeyId(data, length);
+  } else if (type == widevine::Cdm::kCenc) {
+    ParseBoxes(data, length);
+  }
+}
+
+// Init data may carry several boxes back to back, one pssh per DRM system.
+// Some packagers add the protection scheme info of the track as well, its
+// tenc box is looked for in there.
+void InitData::ParseBoxes(const uint8_t* data, uint32_t length) {
+  while (length >= 8) {
+    const uint32_t boxSize = ReadBigEndian32(data);
+
+    if ((boxSize < 8) || (boxSize > length)) {
+      break;
+    }
+
+    const uint32_t boxType = ReadBigEndian32(&data[4]);
+
+    if (boxType == FourCC('p', 's', 's', 'h')) {
+      ParsePssh(data, boxSize);
+    } else if (boxType == FourCC('t', 'e', 'n', 'c')) {
+      ParseTenc(data, boxSize);
+    } else if ((boxType == FourCC('s', 'i', 'n', 'f')) || (boxType == FourCC('s', 'c', 'h', 'i'))) {
+      ParseBoxes(&data[8], boxSize - 8);
+    }
+
+    data += boxSize;
+    length -= boxSize;
+  }
+}
+
+void InitData::ParsePssh(const uint8_t* data, uint32_t boxSize) {
+  if ((boxSize >= 32) && (::memcmp(&data[12], WidevineSystemId, sizeof(WidevineSystemId)) == 0)) {
+    const uint8_t version = data[8];
+    uint32_t offset = 28;
+
+    if (version > 0) {
+      const uint32_t count = ReadBigEndian32(&data[28]);
+      offset += 4;
+      for (uint32_t index = 0; (index < count) && ((offset + 16) <= boxSize); index++, offset += 16) {
+        AddKeyId(&data[offset], 16);
+      }
+    }
+    if ((offset + 4) <= boxSize) {
+      const uint32_t dataSize = ReadBigEndian32(&data[offset]);
+      offset += 4;
+      if (dataSize <= (boxSize - offset)) {
+        ParseWidevineData(&data[offset], dataSize);
+      }
+    }
+  }
+}
+
+// Only version 1 of the box carries the crypt:skip pattern, in the nibbles of
+// the byte following the version and flags and a reserved byte.
+void InitData::ParseTenc(const uint8_t* data, uint32_t boxSize) {
+  if ((boxSize >= 32) && (data[8] >= 1)) {
+    _pattern = true;
+    _cryptBlocks = (data[13] >> 4);
+    _skipBlocks = (data[13] & 0x0F);
+  }
+}
+
+void InitData::ParseWidevineData(const uint8_t* data, uint32_t length) {
+  const uint8_t* end = data + length;
+
+  while (data < end) {
+    uint64_t tag;
+    uint64_t value;
+
+    if (ReadVarint(data, end, tag) == false) {
+      break;
+    }
+
+    const uint32_t field = static_cast<uint32_t>(tag >> 3);
+    const uint8_t wireType = static_cast<uint8_t>(tag & 0x07);
+
+    if (wireType == WireVarint) {
+      if (ReadVarint(data, end, value) == false) {
+        break;
+      }
+      if (field == FieldProtectionScheme) {
+        switch (static_cast<uint32_t>(value)) {
+        case 0x63626331: // 'cbc1'
+          _scheme = PROTECTION_CBC1;
+          break;
+        case 0x63656E73: // 'cens'
+          _scheme = PROTECTION_CENS;
+          break;
+        case 0x63626373: // 'cbcs'
+          _scheme = PROTECTION_CBCS;
+          break;
+        default:
+          _scheme = PROTECTION_CENC;
+          break;
+        }
+      }
+    } else if (wireType == WireLengthDelimited) {
+      if ((ReadVarint(data, end, value) == false) || (value > static_cast<uint64_t>(end - data))) {
+        break;
+      }
+      if (field == FieldKeyId) {
+        AddKeyId(data, static_cast<uint32_t>(value));
+      } else if (field == FieldTrackType) {
+        // "AUDIO", or a video class such as "SD", "HD" or "UHD1".
+        const std::string track(reinterpret_cast<const char*>(data), static_cast<size_t>(value));
+        _track = (track == "AUDIO" ? TRACK_AUDIO : TRACK_VIDEO);
+      }
+      data += value;
+    } else if ((wireType == WireFixed64) && ((end - data) >= 8)) {
+      data += 8;
+    } else if ((wireType == WireFixed32) && ((end - data) >= 4)) {
+      data += 4;
+    } else {
+      break;
+    }
+  }
+}
+
+void InitData::AddKeyId(const uint8_t* keyId, uint32_t length) {
+  if (length != 0) {
+    std::string entry(reinterpret_cast<const char*>(keyId), length);
+    if (std::find(_keyIds.begin(), _keyIds.end(), entry) == _keyIds.end()) {
+      _keyIds.push_back(entry);
+    }
+  }
+}
+
+}  // namespace CDMi
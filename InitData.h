@@ -0,0 +1,97 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cdm.h>
+
+#include <string>
+#include <vector>
+
+namespace CDMi {
+
+// Pulls what the decrypt path needs to know out of the init data handed to
+// MediaKeySession::Init: the Widevine PSSH box for "cenc", the raw key id for
+// "webm", and the tenc box if the "cenc" init data has it. Fields that are
+// absent keep their defaults.
+class InitData {
+public:
+  enum ProtectionScheme : uint8_t {
+    PROTECTION_CENC = 0,
+    PROTECTION_CBC1,
+    PROTECTION_CENS,
+    PROTECTION_CBCS,
+    PROTECTION_COUNT
+  };
+
+  enum TrackType : uint8_t {
+    TRACK_UNKNOWN = 0,
+    TRACK_AUDIO,
+    TRACK_VIDEO
+  };
+
+public:
+  InitData(const InitData&) = delete;
+  InitData& operator=(const InitData&) = delete;
+
+  InitData();
+  ~InitData();
+
+public:
+  void Parse(widevine::Cdm::InitDataType type, const std::string& initData);
+
+  inline ProtectionScheme Scheme() const {
+    return (_scheme);
+  }
+  inline TrackType Track() const {
+    return (_track);
+  }
+  // The crypt:skip pattern of cens and cbcs, if the init data signals it.
+  inline bool HasPattern() const {
+    return (_pattern);
+  }
+  inline uint8_t CryptBlocks() const {
+    return (_cryptBlocks);
+  }
+  inline uint8_t SkipBlocks() const {
+    return (_skipBlocks);
+  }
+  inline const std::vector<std::string>& KeyIds() const {
+    return (_keyIds);
+  }
+
+  static const char* SchemeName(ProtectionScheme scheme);
+
+private:
+  void ParseBoxes(const uint8_t* data, uint32_t length);
+  void ParsePssh(const uint8_t* data, uint32_t boxSize);
+  void ParseTenc(const uint8_t* data, uint32_t boxSize);
+  void ParseWidevineData(const uint8_t* data, uint32_t length);
+  void AddKeyId(const uint8_t* keyId, uint32_t length);
+
+private:
+  ProtectionScheme _scheme;
+  TrackType _track;
+  bool _pattern;
+  uint8_t _cryptBlocks;
+  uint8_t _skipBlocks;
+  std::vector<std::string> _keyIds;
+};
+
+}  // namespace CDMi
@@ -0,0 +1,110 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "KeyStatusNotifier.h"
+
+namespace CDMi {
+
+constexpr uint32_t KeyStatusNotifier::CoalesceMs;
+
+KeyStatusNotifier::KeyStatusNotifier()
+  : _adminLock()
+  , _signal()
+  , _queue()
+  , _pending()
+  , _worker()
+  , _handler()
+  , _running(false)
+  , _scheduled(0)
+  , _delivered(0) {
+}
+
+KeyStatusNotifier::~KeyStatusNotifier() {
+  Stop();
+}
+
+void KeyStatusNotifier::Start(const Handler& handler) {
+  if (_worker.joinable() == false) {
+    _handler = handler;
+    _running = true;
+    _worker = std::thread(&KeyStatusNotifier::Run, this);
+  }
+}
+
+void KeyStatusNotifier::Stop() {
+  if (_worker.joinable() == true) {
+    {
+      std::lock_guard<std::mutex> guard(_adminLock);
+      _running = false;
+    }
+    _signal.notify_one();
+    _worker.join();
+  }
+
+  _queue.clear();
+  _pending.clear();
+}
+
+void KeyStatusNotifier::Schedule(const std::string& sessionId) {
+  std::unique_lock<std::mutex> guard(_adminLock);
+
+  _scheduled++;
+
+  if (_running == false) {
+    guard.unlock();
+    if (_handler) {
+      _delivered++;
+      _handler(sessionId);
+    }
+  } else if (_pending.insert(sessionId).second == true) {
+    Pending entry;
+    entry.sessionId = sessionId;
+    entry.due = Clock::now() + std::chrono::milliseconds(CoalesceMs);
+    _queue.push_back(entry);
+    if (_queue.size() == 1) {
+      _signal.notify_one();
+    }
+  }
+}
+
+void KeyStatusNotifier::Run() {
+  std::unique_lock<std::mutex> guard(_adminLock);
+
+  while (_running == true) {
+    if (_queue.empty() == true) {
+      _signal.wait(guard);
+    } else if (Clock::now() < _queue.front().due) {
+      _signal.wait_until(guard, _queue.front().due);
+    } else {
+      // Changes arriving from here on need a new delivery, the handler may
+      // already have read the statuses.
+      const std::string sessionId(_queue.front().sessionId);
+      _queue.pop_front();
+      _pending.erase(sessionId);
+
+      guard.unlock();
+      _delivered++;
+      _handler(sessionId);
+      guard.lock();
+    }
+  }
+}
+
+}  // namespace CDMi
@@ -0,0 +1,91 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+
+namespace CDMi {
+
+// Moves key status reporting off the CDM thread. A session with changed
+// key statuses is scheduled here, further changes within the coalescing
+// window ride along, and the notifier thread then hands the session id to
+// the handler, which reports what changed in one go.
+class KeyStatusNotifier {
+public:
+  typedef std::function<void(const std::string& sessionId)> Handler;
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Pending {
+    std::string sessionId;
+    Clock::time_point due;
+  };
+
+  static constexpr uint32_t CoalesceMs = 10;
+
+public:
+  KeyStatusNotifier(const KeyStatusNotifier&) = delete;
+  KeyStatusNotifier& operator=(const KeyStatusNotifier&) = delete;
+
+  KeyStatusNotifier();
+  ~KeyStatusNotifier();
+
+public:
+  void Start(const Handler& handler);
+
+  // Pending notifications are dropped.
+  void Stop();
+
+  // Without a running notifier the handler is called right away.
+  void Schedule(const std::string& sessionId);
+
+  inline uint32_t Scheduled() const {
+    return (_scheduled);
+  }
+  inline uint32_t Delivered() const {
+    return (_delivered);
+  }
+
+private:
+  void Run();
+
+private:
+  std::mutex _adminLock;
+  std::condition_variable _signal;
+  std::deque<Pending> _queue;
+  std::unordered_set<std::string> _pending;
+  std::thread _worker;
+  Handler _handler;
+  bool _running;
+  std::atomic<uint32_t> _scheduled;
+  std::atomic<uint32_t> _delivered;
+};
+
+}  // namespace CDMi
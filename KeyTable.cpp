@@ -0,0 +1,248 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "KeyTable.h"
+
+namespace CDMi {
+
+constexpr uint8_t KeyTable::MaximumWaiting;
+
+KeyDirectory::KeyDirectory()
+  : _adminLock()
+  , _keys(new CountMap()) {
+}
+
+KeyDirectory::~KeyDirectory() {
+}
+
+void KeyDirectory::Add(const KeyId& keyId) {
+  _adminLock.Lock();
+
+  CountMap* keys = new CountMap(_keys.Current());
+  (*keys)[keyId]++;
+  _keys.Publish(keys);
+
+  _adminLock.Unlock();
+}
+
+void KeyDirectory::Remove(const KeyId& keyId) {
+  _adminLock.Lock();
+
+  const CountMap& current(_keys.Current());
+  CountMap::const_iterator index(current.find(keyId));
+  if (index != current.end()) {
+    CountMap* keys = new CountMap(current);
+    if (index->second > 1) {
+      (*keys)[keyId]--;
+    } else {
+      keys->erase(keyId);
+    }
+    _keys.Publish(keys);
+  }
+
+  _adminLock.Unlock();
+}
+
+KeyTable::KeyTable(KeyDirectory& directory, DecryptMetrics& metrics)
+  : _adminLock()
+  , _statuses(new StatusMap())
+  , _valid(false)
+  , _directory(directory)
+  , _metrics(metrics)
+  , _waiting()
+  , _waitingCount(0) {
+}
+
+KeyTable::~KeyTable() {
+  for (const auto& entry : _statuses.Current()) {
+    if (entry.second.usable == true) {
+      _directory.Remove(entry.first);
+    }
+  }
+}
+
+void KeyTable::Update(const widevine::Cdm::KeyStatusMap& statuses) {
+  StatusMap* table = new StatusMap(statuses.size());
+  const uint64_t now = DecryptMetrics::Now();
+  bool arrived = false;
+
+  _adminLock.Lock();
+
+  const StatusMap& current(_statuses.Current());
+
+  for (const auto& entry : statuses) {
+    const KeyId keyId(reinterpret_cast<const uint8_t*>(entry.first.data()), static_cast<uint8_t>(entry.first.size()));
+    const bool usable = (entry.second == widevine::Cdm::kUsable);
+    StatusMap::const_iterator previous(current.find(keyId));
+
+    if (usable == true) {
+      if ((previous == current.end()) || (previous->second.status != widevine::Cdm::kUsable)) {
+        WaitMap::iterator waiting(_waiting.find(keyId));
+        if (waiting != _waiting.end()) {
+          _metrics.Record(DecryptStatistics::STAGE_KEY_ROTATION, now - waiting->second);
+          _waiting.erase(waiting);
+        }
+        arrived = true;
+      }
+    } else if ((entry.second == widevine::Cdm::kStatusPending) && (_waiting.size() < MaximumWaiting)) {
+      // Announced ahead of its license, the wait starts here.
+      _waiting.insert(WaitMap::value_type(keyId, now));
+    }
+
+    Entry& slot((*table)[keyId]);
+    slot.status = entry.second;
+    slot.usable = usable;
+  }
+
+  if (arrived == false) {
+    // Nothing new to switch to, keep decrypting with what was usable unless
+    // the CDM says it is gone for good.
+    for (const auto& entry : current) {
+      if (entry.second.usable == true) {
+        StatusMap::iterator index(table->find(entry.first));
+        if (index == table->end()) {
+          table->insert(entry);
+        } else if (index->second.status == widevine::Cdm::kStatusPending) {
+          index->second.usable = true;
+        }
+      }
+    }
+  }
+
+  _waitingCount = static_cast<uint8_t>(_waiting.size());
+  Publish(table);
+  _valid = true;
+
+  _adminLock.Unlock();
+}
+
+void KeyTable::Release() {
+  _adminLock.Lock();
+
+  StatusMap* table = new StatusMap(_statuses.Current());
+  for (auto& entry : *table) {
+    entry.second.status = widevine::Cdm::kReleased;
+    entry.second.usable = false;
+  }
+
+  _waiting.clear();
+  _waitingCount = 0;
+  Publish(table);
+
+  _adminLock.Unlock();
+}
+
+bool KeyTable::HasUsableKey() const {
+  RcuPointer<StatusMap>::ReadGuard table(_statuses);
+
+  for (const auto& entry : *table) {
+    if (entry.second.usable == true) {
+      return (true);
+    }
+  }
+  return (false);
+}
+
+bool KeyTable::IsUsable(const uint8_t* keyId, uint8_t length) {
+  bool usable = false;
+
+  if ((keyId == nullptr) || (length == 0)) {
+    usable = HasUsableKey();
+  } else {
+    const KeyId key(keyId, length);
+
+    {
+      RcuPointer<StatusMap>::ReadGuard table(_statuses);
+      StatusMap::const_iterator index(table->find(key));
+      usable = ((index != table->end()) && (index->second.usable == true));
+    }
+
+    if (usable == false) {
+      if (_directory.IsUsable(key) == true) {
+        _metrics.Routed();
+        if (_waitingCount != 0) {
+          Served(key);
+        }
+        usable = true;
+      } else {
+        Wait(key);
+      }
+    }
+  }
+
+  return (usable);
+}
+
+// Called with the writer lock held.
+void KeyTable::Publish(StatusMap* table) {
+  const StatusMap& current(_statuses.Current());
+
+  // Announce new keys before and withdraw old ones after the swap, so the
+  // directory never misses a key that is usable throughout.
+  for (const auto& entry : *table) {
+    if (entry.second.usable == true) {
+      StatusMap::const_iterator previous(current.find(entry.first));
+      if ((previous == current.end()) || (previous->second.usable == false)) {
+        _directory.Add(entry.first);
+      }
+    }
+  }
+
+  std::vector<KeyId> withdrawn;
+  for (const auto& entry : current) {
+    if (entry.second.usable == true) {
+      StatusMap::const_iterator next(table->find(entry.first));
+      if ((next == table->end()) || (next->second.usable == false)) {
+        withdrawn.push_back(entry.first);
+      }
+    }
+  }
+
+  _statuses.Publish(table);
+
+  for (const KeyId& keyId : withdrawn) {
+    _directory.Remove(keyId);
+  }
+}
+
+// A decrypt found its key missing. The table must be released before the
+// lock is taken, Update holds the lock while waiting for readers.
+void KeyTable::Wait(const KeyId& keyId) {
+  _adminLock.Lock();
+  if (_waiting.size() < MaximumWaiting) {
+    _waiting.insert(WaitMap::value_type(keyId, DecryptMetrics::Now()));
+    _waitingCount = static_cast<uint8_t>(_waiting.size());
+  }
+  _adminLock.Unlock();
+}
+
+// The key waited for became usable through another session.
+void KeyTable::Served(const KeyId& keyId) {
+  _adminLock.Lock();
+  WaitMap::iterator waiting(_waiting.find(keyId));
+  if (waiting != _waiting.end()) {
+    _metrics.Record(DecryptStatistics::STAGE_KEY_ROTATION, DecryptMetrics::Now() - waiting->second);
+    _waiting.erase(waiting);
+    _waitingCount = static_cast<uint8_t>(_waiting.size());
+  }
+  _adminLock.Unlock();
+}
+
+}  // namespace CDMi
@@ -0,0 +1,153 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include "DecryptStatistics.h"
+#include "Rcu.h"
+
+#include <cdm.h>
+
+#include <core/core.h>
+
+#include <atomic>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+
+namespace CDMi {
+
+struct KeyId {
+  KeyId()
+    : length(0) {
+  }
+  KeyId(const uint8_t* data, uint8_t size)
+    : length(size > sizeof(bytes) ? sizeof(bytes) : size) {
+    ::memset(bytes, 0, sizeof(bytes));
+    ::memcpy(bytes, data, length);
+  }
+
+  inline bool operator==(const KeyId& RHS) const {
+    return ((length == RHS.length) && (::memcmp(bytes, RHS.bytes, length) == 0));
+  }
+
+  uint8_t bytes[16];
+  uint8_t length;
+};
+
+struct KeyIdHash {
+  inline size_t operator()(const KeyId& keyId) const {
+    // Key ids are random, the leading bytes are as good as any hash.
+    size_t value;
+    ::memcpy(&value, keyId.bytes, sizeof(value));
+    return (value ^ keyId.length);
+  }
+};
+
+// Usable keys of all sessions on one CDM. widevine::Cdm::decrypt looks its
+// key up by id in whichever session loaded it, so a sample may be decrypted
+// with a key that arrived through another session, e.g. when audio and video
+// are licensed separately.
+class KeyDirectory {
+private:
+  // Number of sessions holding the key usable.
+  typedef std::unordered_map<KeyId, uint32_t, KeyIdHash> CountMap;
+
+public:
+  KeyDirectory(const KeyDirectory&) = delete;
+  KeyDirectory& operator=(const KeyDirectory&) = delete;
+
+  KeyDirectory();
+  ~KeyDirectory();
+
+public:
+  void Add(const KeyId& keyId);
+  void Remove(const KeyId& keyId);
+
+  inline bool IsUsable(const KeyId& keyId) const {
+    RcuPointer<CountMap>::ReadGuard keys(_keys);
+    return (keys->find(keyId) != keys->end());
+  }
+
+private:
+  WPEFramework::Core::CriticalSection _adminLock;
+  RcuPointer<CountMap> _keys;
+};
+
+// Last known status of every key in a session, refreshed from the CDM key
+// status callbacks so Decrypt can check its key without asking the CDM or
+// taking a lock. On key rotation the license update may report the current
+// key as pending or drop it before its successor is usable; such a key stays
+// usable until a new key arrived, so decrypts never stall in between. The
+// time a key was waited for until it became usable is recorded as the
+// key-rotation latency.
+class KeyTable {
+private:
+  struct Entry {
+    widevine::Cdm::KeyStatus status;
+    // Differs from the status while the key is held over, see Update.
+    bool usable;
+  };
+
+  typedef std::unordered_map<KeyId, Entry, KeyIdHash> StatusMap;
+  typedef std::unordered_map<KeyId, uint64_t, KeyIdHash> WaitMap;
+
+  // Samples carry whatever key id the stream says, do not track them all.
+  static constexpr uint8_t MaximumWaiting = 16;
+
+public:
+  KeyTable(const KeyTable&) = delete;
+  KeyTable& operator=(const KeyTable&) = delete;
+
+  KeyTable(KeyDirectory& directory, DecryptMetrics& metrics);
+  ~KeyTable();
+
+public:
+  inline bool IsValid() const {
+    return (_valid);
+  }
+
+  void Update(const widevine::Cdm::KeyStatusMap& statuses);
+  void Release();
+
+  bool HasUsableKey() const;
+
+  // Without a key id any usable key will do, the CDM selects the key. Keys
+  // another session on the same CDM holds are usable as well.
+  bool IsUsable(const uint8_t* keyId, uint8_t length);
+
+private:
+  void Publish(StatusMap* table);
+  void Wait(const KeyId& keyId);
+  void Served(const KeyId& keyId);
+
+private:
+  // Serializes writers and guards _waiting. Never taken while reading the
+  // table, Publish waits for the readers.
+  WPEFramework::Core::CriticalSection _adminLock;
+  RcuPointer<StatusMap> _statuses;
+  std::atomic<bool> _valid;
+  KeyDirectory& _directory;
+  DecryptMetrics& _metrics;
+  WaitMap _waiting;
+  std::atomic<uint8_t> _waitingCount;
+};
+
+}  // namespace CDMi
@@ -0,0 +1,202 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "LicenseCache.h"
+
+#include <core/core.h>
+
+namespace CDMi {
+
+constexpr int64_t LicenseCache::MaximumIdleMs;
+constexpr int64_t LicenseCache::ExpirationMarginMs;
+
+LicenseCache::LicenseCache()
+  : _adminLock()
+  , _entries()
+  , _index()
+  , _cdm(nullptr)
+  , _cdmLock(nullptr)
+  , _clock(nullptr)
+  , _capacity(0)
+  , _hits(0)
+  , _misses(0) {
+}
+
+LicenseCache::~LicenseCache() {
+  Clear();
+}
+
+/* static */ std::string LicenseCache::Key(const char* initDataType, const uint8_t* initData, uint32_t initDataLength) {
+  std::string key;
+
+  if ((initData != nullptr) && (initDataLength != 0)) {
+    key.assign(initDataType != nullptr ? initDataType : "");
+    key += ':';
+    key.append(reinterpret_cast<const char*>(initData), initDataLength);
+  }
+  return (key);
+}
+
+void LicenseCache::Configure(widevine::Cdm* cdm, CountingLock& cdmLock, widevine::Cdm::IClock& clock, uint8_t capacity) {
+  _cdm = cdm;
+  _cdmLock = &cdmLock;
+  _clock = &clock;
+  _capacity = (cdm != nullptr ? capacity : 0);
+  _index.reserve(_capacity);
+}
+
+bool LicenseCache::Park(const std::string& key, const std::string& sessionId) {
+  std::vector<std::string> evicted;
+
+  if ((IsEnabled() == false) || (key.empty() == true)) {
+    return (false);
+  }
+
+  const int64_t now = _clock->now();
+
+  _adminLock.lock();
+
+  Expire(now, evicted);
+
+  EntryMap::iterator index(_index.find(key));
+  if (index != _index.end()) {
+    // Same content again, the newer license wins.
+    evicted.push_back(index->second->sessionId);
+    _entries.erase(index->second);
+    _index.erase(index);
+  }
+
+  _entries.push_front(Entry{ key, sessionId, now });
+  _index[key] = _entries.begin();
+
+  while (_entries.size() > _capacity) {
+    evicted.push_back(_entries.back().sessionId);
+    _index.erase(_entries.back().key);
+    _entries.pop_back();
+  }
+
+  _adminLock.unlock();
+
+  Close(evicted);
+
+  return (true);
+}
+
+std::string LicenseCache::Take(const std::string& key) {
+  std::vector<std::string> evicted;
+  std::string sessionId;
+  int64_t parked = 0;
+
+  if ((IsEnabled() == false) || (key.empty() == true)) {
+    return (sessionId);
+  }
+
+  _adminLock.lock();
+
+  Expire(_clock->now(), evicted);
+
+  EntryMap::iterator index(_index.find(key));
+  if (index != _index.end()) {
+    sessionId = index->second->sessionId;
+    parked = index->second->parked;
+    _entries.erase(index->second);
+    _index.erase(index);
+  }
+
+  _adminLock.unlock();
+
+  if ((sessionId.empty() == false) && (IsValid(sessionId, parked) == false)) {
+    evicted.push_back(sessionId);
+    sessionId.clear();
+  }
+
+  Close(evicted);
+
+  if (sessionId.empty() == true) {
+    _misses++;
+  } else {
+    _hits++;
+  }
+
+  return (sessionId);
+}
+
+void LicenseCache::Clear() {
+  std::vector<std::string> evicted;
+
+  _adminLock.lock();
+  for (const Entry& entry : _entries) {
+    evicted.push_back(entry.sessionId);
+  }
+  _entries.clear();
+  _index.clear();
+  _adminLock.unlock();
+
+  Close(evicted);
+}
+
+// Entries are kept most recently parked first, so the idle ones are at the
+// back. Called with _adminLock held, the sessions are closed by the caller.
+void LicenseCache::Expire(int64_t now, std::vector<std::string>& evicted) {
+  while ((_entries.empty() == false) && ((now - _entries.back().parked) > MaximumIdleMs)) {
+    evicted.push_back(_entries.back().sessionId);
+    _index.erase(_entries.back().key);
+    _entries.pop_back();
+  }
+}
+
+// The license must not be about to expire and must still unlock a key.
+bool LicenseCache::IsValid(const std::string& sessionId, int64_t parked) {
+  const int64_t now = _clock->now();
+  int64_t expiration = 0;
+  widevine::Cdm::KeyStatusMap statuses;
+  bool usable = false;
+
+  if ((now - parked) > MaximumIdleMs) {
+    return (false);
+  }
+
+  _cdmLock->Lock();
+  if ((_cdm->getExpiration(sessionId, &expiration) == widevine::Cdm::kSuccess) &&
+      ((expiration <= 0) || (expiration > (now + ExpirationMarginMs))) &&
+      (_cdm->getKeyStatuses(sessionId, &statuses) == widevine::Cdm::kSuccess)) {
+    for (const auto& entry : statuses) {
+      if (entry.second == widevine::Cdm::kUsable) {
+        usable = true;
+        break;
+      }
+    }
+  }
+  _cdmLock->Unlock();
+
+  return (usable);
+}
+
+void LicenseCache::Close(const std::vector<std::string>& sessionIds) {
+  for (const std::string& sessionId : sessionIds) {
+    _cdmLock->Lock();
+    if (_cdm->close(sessionId) != widevine::Cdm::kSuccess) {
+      TRACE_L1("Could not close parked session %s", sessionId.c_str());
+    }
+    _cdmLock->Unlock();
+  }
+}
+
+}  // namespace CDMi
@@ -0,0 +1,108 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include "CountingLock.h"
+
+#include <cdm.h>
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace CDMi {
+
+// Temporary licenses only live inside their CDM session, so instead of
+// closing the session of a licensed stream it is parked here, keyed by its
+// init data. Re-entering the same content picks the session up again and
+// skips the license round-trip. Parked sessions are evicted least recently
+// used first and once idle for too long, checked whenever a session is parked
+// or taken. Whether the license expired is only known when it is taken.
+class LicenseCache {
+private:
+  struct Entry {
+    std::string key;
+    std::string sessionId;
+    int64_t parked;
+  };
+
+  typedef std::list<Entry> EntryList;
+  typedef std::unordered_map<std::string, EntryList::iterator> EntryMap;
+
+  // A parked session holds a CDM session slot, do not keep it forever.
+  static constexpr int64_t MaximumIdleMs = 30 * 60 * 1000;
+
+  // Licenses that expire within this margin are not worth restoring.
+  static constexpr int64_t ExpirationMarginMs = 10 * 1000;
+
+public:
+  LicenseCache(const LicenseCache&) = delete;
+  LicenseCache& operator=(const LicenseCache&) = delete;
+
+  LicenseCache();
+  ~LicenseCache();
+
+public:
+  static std::string Key(const char* initDataType, const uint8_t* initData, uint32_t initDataLength);
+
+  void Configure(widevine::Cdm* cdm, CountingLock& cdmLock, widevine::Cdm::IClock& clock, uint8_t capacity);
+
+  inline bool IsEnabled() const {
+    return (_capacity != 0);
+  }
+
+  // Takes over the CDM session, false if the cache is disabled.
+  bool Park(const std::string& key, const std::string& sessionId);
+
+  // The CDM session holding a still valid license for the key, empty if none.
+  std::string Take(const std::string& key);
+
+  // Closes all parked CDM sessions.
+  void Clear();
+
+  inline uint32_t Hits() const {
+    return (_hits);
+  }
+  inline uint32_t Misses() const {
+    return (_misses);
+  }
+
+private:
+  void Expire(int64_t now, std::vector<std::string>& evicted);
+  bool IsValid(const std::string& sessionId, int64_t parked);
+  void Close(const std::vector<std::string>& sessionIds);
+
+private:
+  std::mutex _adminLock;
+  EntryList _entries;
+  EntryMap _index;
+  widevine::Cdm* _cdm;
+  CountingLock* _cdmLock;
+  widevine::Cdm::IClock* _clock;
+  uint8_t _capacity;
+  std::atomic<uint32_t> _hits;
+  std::atomic<uint32_t> _misses;
+};
+
+}  // namespace CDMi
@@ -18,11 +18,13 @@
 #include "MediaSession.h"
 #include "Policy.h"
 
+#include <algorithm>
 #include <assert.h>
 #include <iostream>
 #include <openssl/aes.h>
 #include <openssl/evp.h>
 #include <sstream>
+#include <stdio.h>
 #include <string>
 #include <string.h>
 #include <sys/utsname.h>
@@ -32,40 +34,72 @@
 #define NYI_KEYSYSTEM "keysystem-placeholder"
 
 #include <nexus_memory.h>
+#include <nexus_platform.h>
 
 using namespace std;
 
 namespace CDMi {
 
-WPEFramework::Core::CriticalSection g_lock;
-
-MediaKeySession::MediaKeySession(widevine::Cdm *cdm, int32_t licenseType)
+MediaKeySession::MediaKeySession(widevine::Cdm *cdm, CountingLock& cdmLock, KeyDirectory& keys, const std::string& sessionId)
     : m_cdm(cdm)
+    , m_cdmLock(cdmLock)
+    , m_decryptLock()
     , m_CDMData("")
     , m_initData("")
     , m_initDataType(widevine::Cdm::kCenc)
-    , m_licenseType((widevine::Cdm::SessionType)licenseType)
-    , m_sessionId("")
-    , m_TokenHandle(nullptr)
-    , m_pNexusMemory(nullptr)
-    , m_NexusMemorySize(512 * 1024) {
-
-  m_cdm->createSession(m_licenseType, &m_sessionId);
+    , m_initInfo()
+    , m_audio(false)
+    , m_pattern()
+    , m_secureRegions(false)
+    , m_region()
+    , m_metrics()
+    , m_keyTable(keys, m_metrics)
+    , m_licenseType(widevine::Cdm::kTemporary)
+    , m_sessionId(sessionId)
+    , m_cacheKey()
+    , m_restored(true)
+    , m_piCallback(nullptr)
+    , m_statusLock()
+    , m_latestStatuses()
+    , m_reportedStatuses()
+    , m_detached(false)
+    , m_securePool(m_metrics)
+    , m_secureCopy(m_metrics)
+    , m_schemeSamples()
+    , m_asyncCallback(nullptr)
+    , m_asyncQueue()
+    , m_asyncWorker()
+    , m_asyncRunning(false)
+    , m_asyncWaiting(false)
+    , m_asyncLock()
+    , m_asyncSignal()
+    , m_input(m_metrics) {
 
   ::memset(m_IV, 0 , sizeof(m_IV));
+}
 
-  NEXUS_Memory_Allocate(m_NexusMemorySize, nullptr, &m_pNexusMemory);
-  if (!m_pNexusMemory) {
-    printf("Memory allocation failure\n");
-    m_NexusMemorySize = 0;
-  }
+MediaKeySession::MediaKeySession(widevine::Cdm *cdm, CountingLock& cdmLock, KeyDirectory& keys, int32_t licenseType)
+    : MediaKeySession(cdm, cdmLock, keys, std::string()) {
+
+  m_licenseType = (widevine::Cdm::SessionType)licenseType;
+  m_restored = false;
+
+  m_cdm->createSession(m_licenseType, &m_sessionId);
 }
 
+constexpr uint32_t MediaKeySession::AsyncQueueDepth;
+
 MediaKeySession::~MediaKeySession(void) {
 
-    if (m_pNexusMemory) {
-      NEXUS_Memory_Free(m_pNexusMemory);
-      m_NexusMemorySize = 0;
+    DisableAsync();
+
+    TRACE_L1("Session %s decrypt lock contended %u of %u times", m_sessionId.c_str(),
+        m_decryptLock.Contentions(), m_decryptLock.Acquisitions());
+    for (uint8_t index = 0; index < InitData::PROTECTION_COUNT; index++) {
+      if (m_schemeSamples[index] != 0) {
+        TRACE_L1("Session %s decrypted %u %s samples", m_sessionId.c_str(), m_schemeSamples[index].load(),
+            InitData::SchemeName(static_cast<InitData::ProtectionScheme>(index)));
+      }
     }
 }
 
@@ -73,7 +107,17 @@ MediaKeySession::~MediaKeySession(void) {
 void MediaKeySession::Run(const IMediaKeySessionCallback *f_piMediaKeySessionCallback) {
 
   if (f_piMediaKeySessionCallback) {
-    m_piCallback = const_cast<IMediaKeySessionCallback*>(f_piMediaKeySessionCallback);
+    {
+      std::lock_guard<std::mutex> guard(m_statusLock);
+      m_piCallback = const_cast<IMediaKeySessionCallback*>(f_piMediaKeySessionCallback);
+    }
+
+    if (m_restored == true) {
+      // The license is already there, tell the client its keys are usable.
+      onKeyStatusChange();
+      NotifyKeyStatuses();
+      return;
+    }
 
     widevine::Cdm::Status status = m_cdm->generateRequest(m_sessionId, m_initDataType, m_initData);
     if (widevine::Cdm::kSuccess != status) {
@@ -82,6 +126,7 @@ void MediaKeySession::Run(const IMediaKeySessionCallback *f_piMediaKeySessionCal
     }
   }
   else {
+      std::lock_guard<std::mutex> guard(m_statusLock);
       m_piCallback = nullptr;
   }
 }
@@ -147,7 +192,37 @@ void MediaKeySession::onKeyStatusChange()
     if (widevine::Cdm::kSuccess != m_cdm->getKeyStatuses(m_sessionId, &map))
         return;
 
-    for (const auto& pair : map) {
+    m_keyTable.Update(map);
+
+    // Reported later by NotifyKeyStatuses, off the CDM thread.
+    std::lock_guard<std::mutex> guard(m_statusLock);
+    m_latestStatuses.swap(map);
+}
+
+void MediaKeySession::NotifyKeyStatuses()
+{
+    std::vector<std::pair<std::string, widevine::Cdm::KeyStatus>> changes;
+
+    {
+        std::lock_guard<std::mutex> guard(m_statusLock);
+
+        // Keep the changes for when the client shows up.
+        if (m_piCallback == nullptr)
+            return;
+
+        for (const auto& pair : m_latestStatuses) {
+            widevine::Cdm::KeyStatusMap::const_iterator reported(m_reportedStatuses.find(pair.first));
+            if ((reported == m_reportedStatuses.end()) || (reported->second != pair.second))
+                changes.push_back(pair);
+        }
+        m_reportedStatuses = m_latestStatuses;
+    }
+
+    for (const auto& pair : changes) {
+        // The client may destroy the session from within its callback.
+        if (m_detached == true)
+            return;
+
         const std::string& keyValue = pair.first;
         widevine::Cdm::KeyStatus keyStatus = pair.second;
 
@@ -155,7 +230,8 @@ void MediaKeySession::onKeyStatusChange()
                                         reinterpret_cast<const uint8_t*>(keyValue.c_str()),
                                         keyValue.length());
     }
-    m_piCallback->OnKeyStatusesUpdated();
+    if ((changes.empty() == false) && (m_detached == false))
+        m_piCallback->OnKeyStatusesUpdated();
 }
 
 void MediaKeySession::onKeyStatusError(widevine::Cdm::Status status) {
@@ -187,16 +263,16 @@ void MediaKeySession::onKeyStatusError(widevine::Cdm::Status status) {
 }
 
 void MediaKeySession::onRemoveComplete() {
+    m_keyTable.Release();
+
     widevine::Cdm::KeyStatusMap map;
     if (widevine::Cdm::kSuccess == m_cdm->getKeyStatuses(m_sessionId, &map)) {
-        for (const auto& pair : map) {
-            const std::string& keyValue = pair.first;
-
-            m_piCallback->OnKeyStatusUpdate("KeyReleased",
-                                        reinterpret_cast<const uint8_t*>(keyValue.c_str()),
-                                        keyValue.length());
+        for (auto& pair : map) {
+            pair.second = widevine::Cdm::kReleased;
         }
-        m_piCallback->OnKeyStatusesUpdated();
+
+        std::lock_guard<std::mutex> guard(m_statusLock);
+        m_latestStatuses.swap(map);
     }
 }
 
@@ -210,13 +286,13 @@ void MediaKeySession::onDirectIndividualizationRequest(
 
 CDMi_RESULT MediaKeySession::Load(void) {
   CDMi_RESULT ret = CDMi_S_FALSE;
-  g_lock.Lock();
+  m_cdmLock.Lock();
   widevine::Cdm::Status status = m_cdm->load(m_sessionId);
   if (widevine::Cdm::kSuccess != status)
     onKeyStatusError(status);
   else
     ret = CDMi_SUCCESS;
-  g_lock.Unlock();
+  m_cdmLock.Unlock();
   return ret;
 }
 
@@ -225,35 +301,50 @@ void MediaKeySession::Update(
     uint32_t f_cbKeyMessageResponse) {
   std::string keyResponse(reinterpret_cast<const char*>(f_pbKeyMessageResponse),
       f_cbKeyMessageResponse);
-  g_lock.Lock();
+  m_cdmLock.Lock();
   widevine::Cdm::Status status = m_cdm->update(m_sessionId, keyResponse);
   if (widevine::Cdm::kSuccess != status)
      onKeyStatusChange();
 
-  g_lock.Unlock();
+  m_cdmLock.Unlock();
+
+  if (widevine::Cdm::kSuccess != status) {
+    // No CDM event follows a rejected license, report every key as it is
+    // now so the client learns the update did not take.
+    {
+      std::lock_guard<std::mutex> guard(m_statusLock);
+      m_reportedStatuses.clear();
+    }
+    NotifyKeyStatuses();
+  }
 }
 
 CDMi_RESULT MediaKeySession::Remove(void) {
   CDMi_RESULT ret = CDMi_S_FALSE;
-  g_lock.Lock();
+  m_cdmLock.Lock();
   widevine::Cdm::Status status = m_cdm->remove(m_sessionId);
   if (widevine::Cdm::kSuccess != status)
     onKeyStatusError(status);
   else
     ret =  CDMi_SUCCESS;
-  g_lock.Unlock();
+  m_cdmLock.Unlock();
   return ret;
 }
 
 CDMi_RESULT MediaKeySession::Close(void) {
   CDMi_RESULT status = CDMi_S_FALSE;
-  g_lock.Lock();
+  m_cdmLock.Lock();
   if (widevine::Cdm::kSuccess == m_cdm->close(m_sessionId))
     status = CDMi_SUCCESS;
-  g_lock.Unlock();
+  m_cdmLock.Unlock();
   return status;
 }
 
+bool MediaKeySession::IsReusable() const {
+  return ((m_licenseType == widevine::Cdm::kTemporary) && (m_cacheKey.empty() == false) &&
+          (m_keyTable.HasUsableKey() == true));
+}
+
 const char* MediaKeySession::GetSessionId(void) const {
   return m_sessionId.c_str();
 }
@@ -262,6 +353,55 @@ const char* MediaKeySession::GetKeySystem(void) const {
   return NYI_KEYSYSTEM;//TODO: replace with keysystem and test
 }
 
+// The CDM data is a MIME type with optional parameters, which may have a
+// value: "video/mp4; secure-region; pattern=1:9".
+static bool FindParameter(const std::string& cdmData, const char name[], std::string& value) {
+  const std::string::size_type nameLength = ::strlen(name);
+  std::string::size_type start = 0;
+  while (start <= cdmData.size()) {
+    std::string::size_type end = cdmData.find(';', start);
+    if (end == std::string::npos) {
+      end = cdmData.size();
+    }
+    const std::string::size_type first = cdmData.find_first_not_of(" \t", start);
+    const std::string::size_type last = cdmData.find_last_not_of(" \t", end - 1);
+    if ((first < end) && (last != std::string::npos) && (last >= first) &&
+        (cdmData.compare(first, nameLength, name) == 0)) {
+      const std::string::size_type length = last - first + 1;
+      if (length == nameLength) {
+        value.clear();
+        return (true);
+      }
+      if ((length > nameLength) && (cdmData[first + nameLength] == '=')) {
+        value = cdmData.substr(first + nameLength + 1, length - nameLength - 1);
+        return (true);
+      }
+    }
+    start = end + 1;
+  }
+  return (false);
+}
+
+static bool HasParameter(const std::string& cdmData, const char name[]) {
+  std::string value;
+  return (FindParameter(cdmData, name, value));
+}
+
+// "crypt:skip", both in 16 byte blocks and below 16 as in the tenc box.
+static bool ParsePattern(const std::string& value, widevine::Cdm::Pattern& pattern) {
+  unsigned int crypt;
+  unsigned int skip;
+  char separator;
+  char trailing;
+  if ((::sscanf(value.c_str(), "%u %c %u %c", &crypt, &separator, &skip, &trailing) != 3) ||
+      (separator != ':') || (crypt > 15) || (skip > 15)) {
+    return (false);
+  }
+  pattern.encrypted_blocks = crypt;
+  pattern.clear_blocks = skip;
+  return (true);
+}
+
 CDMi_RESULT MediaKeySession::Init(
     int32_t licenseType,
     const char *f_pwszInitDataType,
@@ -291,11 +431,343 @@ CDMi_RESULT MediaKeySession::Init(
   if (f_pbInitData && f_cbInitData)
     m_initData.assign((const char*) f_pbInitData, f_cbInitData);
 
+  m_initInfo.Parse(m_initDataType, m_initData);
+
   if (f_pbCDMData && f_cbCDMData)
     m_CDMData.assign((const char*) f_pbCDMData, f_cbCDMData);
+
+  // A client may name the track by its MIME type ("audio/mp4") in the CDM
+  // data, otherwise the PSSH decides. Unknown tracks take the video path.
+  if (m_CDMData.compare(0, 6, "audio/") == 0)
+    m_audio = true;
+  else if (m_CDMData.compare(0, 6, "video/") == 0)
+    m_audio = false;
+  else
+    m_audio = (m_initInfo.Track() == InitData::TRACK_AUDIO);
+
+  // Only cens and cbcs leave blocks in the clear. The caller may pass the
+  // pattern in the CDM data, init data with the tenc box carries it too. If
+  // neither does, CMAF mandates 1:9 for video and whole sample encryption
+  // for audio. A pattern that does not fit the scheme, or a caller and init
+  // data that disagree, would only make the CDM produce garbage.
+  const InitData::ProtectionScheme scheme = m_initInfo.Scheme();
+  const bool patterned = (scheme == InitData::PROTECTION_CENS) || (scheme == InitData::PROTECTION_CBCS);
+  std::string value;
+  m_pattern = widevine::Cdm::Pattern();
+  if (FindParameter(m_CDMData, "pattern", value) == true) {
+    if (ParsePattern(value, m_pattern) == false) {
+      TRACE_L1("Invalid pattern \"%s\" in the CDM data", value.c_str());
+      return CDMi_S_FALSE;
+    }
+    if ((m_initInfo.HasPattern() == true) &&
+        ((m_pattern.encrypted_blocks != m_initInfo.CryptBlocks()) || (m_pattern.clear_blocks != m_initInfo.SkipBlocks()))) {
+      TRACE_L1("Pattern %s does not match %u:%u of the init data", value.c_str(), m_initInfo.CryptBlocks(), m_initInfo.SkipBlocks());
+      return CDMi_S_FALSE;
+    }
+  } else if (m_initInfo.HasPattern() == true) {
+    m_pattern.encrypted_blocks = m_initInfo.CryptBlocks();
+    m_pattern.clear_blocks = m_initInfo.SkipBlocks();
+  } else if ((patterned == true) && (m_audio == false)) {
+    m_pattern.encrypted_blocks = 1;
+    m_pattern.clear_blocks = 9;
+  }
+  if (((m_pattern.encrypted_blocks == 0) && (m_pattern.clear_blocks != 0)) ||
+      ((patterned == false) && (m_pattern.encrypted_blocks != 0))) {
+    TRACE_L1("Pattern %u:%u does not fit %s", m_pattern.encrypted_blocks, m_pattern.clear_blocks, InitData::SchemeName(scheme));
+    return CDMi_S_FALSE;
+  }
+
+  // Only a consumer that asked for it understands SecureRegion. The slab is
+  // taken now rather than on the first sample, while the secure heap is
+  // least fragmented.
+  m_secureRegions = ((m_audio == false) && (HasParameter(m_CDMData, "secure-region") == true));
+  if ((m_secureRegions == true) && (SecureSlab::IsEnabled() == true))
+    m_securePool.Reserve();
+
   return CDMi_SUCCESS;
 }
 
+// Moves the big endian block counter in the lower 8 bytes of a CENC IV.
+static void AdvanceCounter(uint8_t iv[16], uint64_t blocks) {
+  uint64_t counter = 0;
+  for (uint8_t index = 8; index < 16; index++) {
+    counter = (counter << 8) | iv[index];
+  }
+  counter += blocks;
+  for (uint8_t index = 15; index >= 8; index--) {
+    iv[index] = static_cast<uint8_t>(counter & 0xFF);
+    counter >>= 8;
+  }
+}
+
+static widevine::Cdm::Status DecryptRange(
+    widevine::Cdm* cdm,
+    widevine::Cdm::InputBuffer& input,
+    widevine::Cdm::OutputBuffer& output,
+    const uint8_t* source,
+    uint32_t offset,
+    uint32_t size,
+    uint32_t first,
+    uint32_t last,
+    uint32_t base) {
+  input.data = source + offset;
+  input.data_length = size;
+  input.first_subsample = (offset == first);
+  input.last_subsample = ((offset + size) == last);
+  output.data_offset = base + offset;
+
+  widevine::Cdm::Status status = cdm->decrypt(input, output);
+  if (widevine::Cdm::kSuccess != status) {
+    printf("CDM decrypt failed: %d\n", status);
+  }
+  return (status);
+}
+
+// Number of 16 byte blocks that are actually encrypted in a range of the given
+// number of blocks, following a crypt:skip pattern.
+static uint64_t PatternBlocks(uint64_t blocks, const widevine::Cdm::Pattern& pattern) {
+  const uint64_t period = pattern.encrypted_blocks + pattern.clear_blocks;
+  if ((pattern.encrypted_blocks == 0) || (period == 0)) {
+    return (blocks);
+  }
+  return ((blocks / period) * pattern.encrypted_blocks) + std::min<uint64_t>(blocks % period, pattern.encrypted_blocks);
+}
+
+// The mapping holds (clear, encrypted) byte counts, two uint32_t entries per
+// subsample. Without a mapping the whole sample is encrypted. Clear ranges are
+// only copied into the output, for video by DMA if the platform has it (see
+// SecureCopy), so the CDM sees just the encrypted ones. For CTR schemes each
+// encrypted range continues the keystream where the previous one stopped,
+// cbc1 chains on the last cipher block of the previous range and cbcs
+// restarts every range with the constant IV.
+bool MediaKeySession::DecryptSubSamples(
+    const uint8_t* source,
+    uint32_t length,
+    void* destination,
+    uint32_t destinationOffset,
+    const uint32_t* subSampleMapping,
+    uint32_t subSampleMappingCount,
+    const uint8_t* keyId,
+    uint8_t keyIdLength) {
+  uint8_t counterBlock[16];
+  const InitData::ProtectionScheme scheme = m_initInfo.Scheme();
+  const bool chained = (scheme == InitData::PROTECTION_CBC1) || (scheme == InitData::PROTECTION_CBCS);
+
+  widevine::Cdm::OutputBuffer output;
+  output.data = reinterpret_cast<uint8_t*>(destination);
+  output.data_length = destinationOffset + length;
+  output.is_secure = (m_audio == false);
+
+  widevine::Cdm::InputBuffer input;
+  input.key_id = keyId;
+  input.key_id_length = keyIdLength;
+  input.iv_length = sizeof(counterBlock);
+  input.is_video = (m_audio == false);
+
+  // Agreed on in Init, for audio as well as video.
+  input.pattern = m_pattern;
+
+  const uint32_t pairs = (subSampleMapping != nullptr ? (subSampleMappingCount / 2) : 0);
+  const uint32_t ranges = (pairs != 0 ? pairs : 1);
+  const bool dma = (m_audio == false) && (m_secureCopy.IsAvailable() == true);
+
+  // The first and last range handed to the CDM carry the subsample flags.
+  uint32_t first = 0;
+  uint32_t last = length;
+  if (dma == true) {
+    uint32_t position = 0;
+    first = length;
+    last = 0;
+    for (uint32_t index = 0; index < ranges; index++) {
+      const uint32_t encrypted = (pairs != 0 ? subSampleMapping[(index * 2) + 1] : length);
+      position += (pairs != 0 ? subSampleMapping[index * 2] : 0);
+      if (encrypted != 0) {
+        first = std::min(first, position);
+        last = position + encrypted;
+      }
+      position += encrypted;
+    }
+  }
+  const uint8_t* chainBlock = m_IV;
+  uint32_t offset = 0;
+  uint64_t keyStreamOffset = 0;
+  widevine::Cdm::Status status = widevine::Cdm::kSuccess;
+  bool result = true;
+
+  for (uint32_t index = 0; (result == true) && (index < ranges); index++) {
+    const uint32_t clear = (pairs != 0 ? subSampleMapping[index * 2] : 0);
+    const uint32_t encrypted = (pairs != 0 ? subSampleMapping[(index * 2) + 1] : length);
+
+    if ((clear > (length - offset)) || (encrypted > (length - offset - clear))) {
+      printf("Subsample mapping exceeds the sample size %d\n", length);
+      m_metrics.Failed(DecryptStatistics::FAILURE_SUBSAMPLE_MAPPING);
+      result = false;
+    } else {
+      if ((clear != 0) && (dma == true)) {
+        result = m_secureCopy.Add(source + offset, output.data + destinationOffset + offset, clear);
+        offset += clear;
+      } else if (clear != 0) {
+        input.encryption_scheme = widevine::Cdm::kClear;
+        input.iv = m_IV;
+        input.block_offset = 0;
+        status = DecryptRange(m_cdm, input, output, source, offset, clear, first, last, destinationOffset);
+        result = (status == widevine::Cdm::kSuccess);
+        offset += clear;
+      }
+      if ((result == true) && (encrypted != 0) && (dma == true)) {
+        // Let the engine move the clear ranges so far while the CDM works.
+        result = m_secureCopy.Start();
+      }
+      if ((result == true) && (encrypted != 0)) {
+        input.block_offset = 0;
+        if (chained == true) {
+          input.encryption_scheme = widevine::Cdm::kAesCbc;
+          input.iv = (scheme == InitData::PROTECTION_CBCS ? m_IV : chainBlock);
+        } else {
+          input.encryption_scheme = widevine::Cdm::kAesCtr;
+          input.iv = counterBlock;
+          input.block_offset = static_cast<uint32_t>(keyStreamOffset % 16);
+          ::memcpy(counterBlock, m_IV, sizeof(counterBlock));
+          AdvanceCounter(counterBlock, keyStreamOffset / 16);
+        }
+
+        status = DecryptRange(m_cdm, input, output, source, offset, encrypted, first, last, destinationOffset);
+        result = (status == widevine::Cdm::kSuccess);
+
+        if (input.pattern.encrypted_blocks == 0) {
+          keyStreamOffset += encrypted;
+        } else {
+          keyStreamOffset += PatternBlocks(encrypted / 16, input.pattern) * 16;
+        }
+        if (encrypted >= 16) {
+          chainBlock = &source[offset + ((encrypted / 16) * 16) - 16];
+        }
+        offset += encrypted;
+      }
+    }
+  }
+
+  if ((dma == true) && (m_secureCopy.Finish() == false)) {
+    result = false;
+  }
+
+  if ((result == true) && (offset != length)) {
+    printf("Subsample mapping covers %d of %d bytes\n", offset, length);
+    m_metrics.Failed(DecryptStatistics::FAILURE_SUBSAMPLE_MAPPING);
+    result = false;
+  }
+
+  if (result == true) {
+    m_schemeSamples[scheme].fetch_add(1, std::memory_order_relaxed);
+  } else if (status != widevine::Cdm::kSuccess) {
+    m_metrics.Failed(DecryptMetrics::FailureOf(status));
+  }
+
+  return (result);
+}
+
+// Input that already lives in device accessible Nexus memory (a buffer the
+// client allocated from Nexus or a shared region mapped from it) is handed to
+// the CDM in place. Plain heap memory is staged in the session buffer, which
+// follows the sample sizes of the stream. Audio is decrypted over its own
+// input, so it is always staged.
+const uint8_t* MediaKeySession::StageInput(const uint8_t* data, uint32_t length) {
+  if ((m_audio == false) && (NEXUS_AddrToOffset(data) != 0)) {
+    m_metrics.ZeroCopy();
+    return (data);
+  }
+
+  const uint64_t start = DecryptMetrics::Now();
+  const uint8_t* staged = m_input.Stage(data, length);
+
+  if (staged != nullptr) {
+    m_metrics.Record(DecryptStatistics::STAGE_COPY, DecryptMetrics::Now() - start);
+  }
+
+  return (staged);
+}
+
+// Decrypts one sample into a secure block, the caller holds m_decryptLock and
+// has verified the key. A token is only handed out for a decrypted sample, a
+// failed one gives its block straight back to the pool.
+CDMi_RESULT MediaKeySession::DecryptSample(Sample& sample) {
+  CDMi_RESULT status = CDMi_S_FALSE;
+
+  sample.token = nullptr;
+  sample.offset = 0;
+
+  memcpy(m_IV, sample.iv, (sample.ivLength > 16 ? 16 : sample.ivLength));
+  if (sample.ivLength < 16) {
+    memset(&(m_IV[sample.ivLength]), 0, 16 - sample.ivLength);
+  }
+
+  const uint64_t start = DecryptMetrics::Now();
+  const SecureBufferPool::Buffer* secureBuffer = nullptr;
+  void* output = nullptr;
+  uint32_t outputOffset = 0;
+
+  if (m_audio == true) {
+    // Audio needs no secure path, the clear sample replaces the input.
+    output = const_cast<uint8_t*>(sample.data);
+  } else {
+    const uint32_t allocations = m_securePool.Allocations();
+
+    // Recycled secure block, only allocates while the pool is warming up.
+    secureBuffer = m_securePool.Acquire(sample.length);
+    m_metrics.Record(DecryptStatistics::STAGE_ALLOCATION, DecryptMetrics::Now() - start);
+    if (m_securePool.Allocations() != allocations) {
+      m_metrics.SecureAllocation();
+    }
+
+    if (secureBuffer == nullptr) {
+      m_metrics.Failed(DecryptStatistics::FAILURE_SECURE_MEMORY);
+    } else {
+      output = secureBuffer->opaque;
+      outputOffset = secureBuffer->offset;
+    }
+  }
+
+  if (output != nullptr) {
+    const uint8_t* source = StageInput(sample.data, sample.length);
+    if (source == nullptr) {
+      if (secureBuffer != nullptr) {
+        m_securePool.Release(secureBuffer->token, secureBuffer->offset);
+      }
+    } else {
+      const uint64_t stamp = DecryptMetrics::Now();
+      if (DecryptSubSamples(source, sample.length, output, outputOffset,
+              sample.subSampleMapping, sample.subSampleMappingCount, sample.keyId, sample.keyIdLength) == true) {
+        m_metrics.Decrypted(sample.length);
+        status = CDMi_SUCCESS;
+      }
+      m_metrics.Record(DecryptStatistics::STAGE_DECRYPT, DecryptMetrics::Now() - stamp);
+      if (secureBuffer == nullptr) {
+        // Audio, decrypted in place.
+      } else if (status == CDMi_SUCCESS) {
+        sample.token = secureBuffer->token;
+        sample.offset = outputOffset;
+      } else {
+        m_securePool.Release(secureBuffer->token, secureBuffer->offset);
+      }
+    }
+  }
+
+  m_metrics.Record(DecryptStatistics::STAGE_SAMPLE, DecryptMetrics::Now() - start);
+
+  return (status);
+}
+
+bool MediaKeySession::IsKeyUsable(const uint8_t* keyId, uint8_t keyIdLength) {
+  // The table follows the key status callbacks, only seed it if none came yet.
+  if (m_keyTable.IsValid() == false) {
+    widevine::Cdm::KeyStatusMap map;
+    if (widevine::Cdm::kSuccess == m_cdm->getKeyStatuses(m_sessionId, &map)) {
+      m_keyTable.Update(map);
+    }
+  }
+  return (m_keyTable.IsUsable(keyId, keyIdLength));
+}
+
 CDMi_RESULT MediaKeySession::Decrypt(
     const uint8_t *f_pbSessionKey,
     uint32_t f_cbSessionKey,
@@ -311,114 +783,189 @@ CDMi_RESULT MediaKeySession::Decrypt(
     const uint8_t* keyId,
     bool /* initWithLast15 */)
 {
-
-  static NEXUS_HeapHandle secureHeap = NEXUS_Heap_Lookup(NEXUS_HeapLookupType_eCompressedRegion);
-
-  g_lock.Lock();
-  widevine::Cdm::KeyStatusMap map;
-  std::string keyStatus;
-
   CDMi_RESULT status = CDMi_S_FALSE;
   *f_pcbOpaqueClearContent = 0;
 
-  memcpy(m_IV, f_pbIV, (f_cbIV > 16 ? 16 : f_cbIV));
-  if (f_cbIV < 16) {
-    memset(&(m_IV[f_cbIV]), 0, 16 - f_cbIV);
+  Sample sample;
+  sample.data = f_pbData;
+  sample.length = f_cbData;
+  sample.iv = f_pbIV;
+  sample.ivLength = f_cbIV;
+  sample.subSampleMapping = f_pdwSubSampleMapping;
+  sample.subSampleMappingCount = f_cdwSubSampleMapping;
+  sample.keyId = keyId;
+  sample.keyIdLength = keyIdLength;
+  sample.token = nullptr;
+  sample.offset = 0;
+  sample.result = CDMi_S_FALSE;
+
+  // Back-pressure is applied before the lock, other decrypts of the session
+  // do not queue up behind a consumer that is slow to release.
+  if (m_audio == false) {
+    m_securePool.Wait();
   }
 
-    // Reallocate input memory if needed.
-  if (f_cbData >  m_NexusMemorySize) {
+  const uint64_t start = DecryptMetrics::Now();
+  m_decryptLock.Lock();
+  m_metrics.Record(DecryptStatistics::STAGE_LOCK_WAIT, DecryptMetrics::Now() - start);
 
-    void *newBuffer = nullptr;
-    int rc = NEXUS_Memory_Allocate(f_cbData, nullptr, &newBuffer);
-    if( rc != 0 ) {
+  if (IsKeyUsable(keyId, keyIdLength) == true) {
+    status = DecryptSample(sample);
+  } else {
+    m_metrics.Failed(DecryptStatistics::FAILURE_KEY_NOT_USABLE);
+  }
 
-        printf("NexusMemory to small, use larger buffer. could not allocate memory %d", f_cbData);
-        return status;
+  if (m_audio == true) {
+    if (status == CDMi_SUCCESS) {
+      // The clear sample is returned in place.
+      *f_pcbOpaqueClearContent = f_cbData;
+      *f_ppbOpaqueClearContent = f_pbData;
+    }
+  } else if (m_secureRegions == true) {
+    if (sample.token != nullptr) {
+      // The output is a region of a shared block, tell the consumer where.
+      SecureRegion region;
+      region.token = sample.token;
+      region.offset = sample.offset;
+      region.length = f_cbData;
+
+      // A sample too short to carry the descriptor gets it from the session,
+      // the caller copies it before it decrypts the next sample.
+      *f_pcbOpaqueClearContent = sizeof(region);
+      *f_ppbOpaqueClearContent = (f_cbData < sizeof(region) ? reinterpret_cast<uint8_t*>(&m_region) : f_pbData);
+      memcpy(*f_ppbOpaqueClearContent, reinterpret_cast<const uint8_t*>(&region), sizeof(region));
     }
+  } else if (sample.token != nullptr) {
+    //Copy and Return the Memory token in the incoming payload buffer.
+    *f_pcbOpaqueClearContent = sizeof(sample.token);
+    *f_ppbOpaqueClearContent = f_pbData;
+    memcpy(*f_ppbOpaqueClearContent,reinterpret_cast<const uint8_t*>(&sample.token),sizeof(sample.token));
+  }
+
+  m_decryptLock.Unlock();
+  return status;
+}
+
+CDMi_RESULT MediaKeySession::DecryptBatch(std::vector<Sample>& samples) {
+  CDMi_RESULT status = CDMi_SUCCESS;
+  const uint8_t* lastKeyId = nullptr;
+  uint8_t lastKeyIdLength = 0;
+  bool usable = false;
 
-    NEXUS_Memory_Free(m_pNexusMemory);
-    m_pNexusMemory = newBuffer;
-    m_NexusMemorySize = f_cbData;
-    printf("NexusMemory to small, use larger buffer. allocate memory %d", f_cbData);
+  // Room for the first sample, the pool drops the oldest tokens for the rest.
+  if (m_audio == false) {
+    m_securePool.Wait();
   }
 
+  const uint64_t start = DecryptMetrics::Now();
+  m_decryptLock.Lock();
+  m_metrics.Record(DecryptStatistics::STAGE_LOCK_WAIT, DecryptMetrics::Now() - start);
+
+  for (Sample& sample : samples) {
+    // A fragment normally uses one key, only look it up when it changes.
+    if ((lastKeyId == nullptr) || (sample.keyIdLength != lastKeyIdLength) ||
+        ((lastKeyIdLength != 0) && (::memcmp(sample.keyId, lastKeyId, lastKeyIdLength) != 0))) {
+      usable = IsKeyUsable(sample.keyId, sample.keyIdLength);
+      lastKeyId = sample.keyId;
+      lastKeyIdLength = sample.keyIdLength;
+    }
 
-  NEXUS_MemoryBlockHandle pNexusMemoryBlock = NEXUS_MemoryBlock_Allocate(secureHeap, f_cbData, 0, nullptr);
-  if (!pNexusMemoryBlock) {
+    if (usable == true) {
+      sample.result = DecryptSample(sample);
+    } else {
+      m_metrics.Failed(DecryptStatistics::FAILURE_KEY_NOT_USABLE);
+      sample.token = nullptr;
+      sample.result = CDMi_S_FALSE;
+    }
 
-    printf("NexusBlockMemory could not allocate %d", f_cbData);
-    return status;
+    if (sample.result != CDMi_SUCCESS) {
+      status = CDMi_S_FALSE;
+    }
   }
 
-  NEXUS_Error rc;
-  void *pOpaqueData = nullptr;
-  rc = NEXUS_MemoryBlock_Lock(pNexusMemoryBlock, &pOpaqueData);
-  if (rc) {
+  m_decryptLock.Unlock();
+
+  return (status);
+}
 
-    printf("NexusBlockMemory is not usable");
-    NEXUS_MemoryBlock_Free(pNexusMemoryBlock);
-    pOpaqueData = nullptr;
-    return status;
+CDMi_RESULT MediaKeySession::EnableAsync(IDecryptCallback* callback) {
+  if ((callback == nullptr) || (m_asyncRunning == true)) {
+    return CDMi_S_FALSE;
   }
 
-  m_TokenHandle = NEXUS_MemoryBlock_CreateToken(pNexusMemoryBlock);
-  if (!m_TokenHandle) {
+  m_asyncCallback = callback;
+  m_asyncRunning = true;
+  m_asyncWorker = std::thread(&MediaKeySession::RunThread, this, 0);
 
-    printf("Could not create a token for another process");
-    NEXUS_MemoryBlock_Unlock(pNexusMemoryBlock);
-    NEXUS_MemoryBlock_Free(pNexusMemoryBlock);
-    pOpaqueData = nullptr;
-    return status;
+  return CDMi_SUCCESS;
+}
+
+void MediaKeySession::DisableAsync() {
+  if (m_asyncWorker.joinable() == true) {
+    {
+      std::lock_guard<std::mutex> guard(m_asyncLock);
+      m_asyncRunning = false;
+    }
+    m_asyncSignal.notify_one();
+    m_asyncWorker.join();
+    m_asyncCallback = nullptr;
   }
+}
 
-  // Copy provided payload to Input of Decryption.
-  ::memcpy(m_pNexusMemory, f_pbData, f_cbData);
+CDMi_RESULT MediaKeySession::DecryptAsync(const Sample& sample) {
+  if ((m_asyncRunning == false) || (m_asyncQueue.Push(sample) == false)) {
+    return CDMi_S_FALSE;
+  }
 
-  if (widevine::Cdm::kSuccess == m_cdm->getKeyStatuses(m_sessionId, &map)) {
-    widevine::Cdm::KeyStatusMap::iterator it = map.begin();
-    // FIXME: We just check the first key? How do we know that's the Widevine key and not, say, a PlayReady one?
-    if (widevine::Cdm::kUsable == it->second) {
-      widevine::Cdm::OutputBuffer output;
-      output.data = reinterpret_cast<uint8_t*>(pOpaqueData);
-      output.data_length = f_cbData;
-      output.is_secure = true;
+  // Only pay for the wakeup if the worker actually went to sleep.
+  if (m_asyncWaiting == true) {
+    std::lock_guard<std::mutex> guard(m_asyncLock);
+    m_asyncSignal.notify_one();
+  }
+  return CDMi_SUCCESS;
+}
 
-      widevine::Cdm::InputBuffer input;
-      input.data = reinterpret_cast<uint8_t*>(m_pNexusMemory);
-      input.data_length = output.data_length;
-      input.key_id = keyId;
-      input.key_id_length = keyIdLength;
-      input.iv = m_IV;
-      input.iv_length = sizeof(m_IV);
+// Worker of the async mode: decrypts queued samples in order and reports each
+// one back. Whatever is still queued when the mode is disabled is reported as
+// failed so the caller can release its buffers.
+void* MediaKeySession::RunThread(int) {
+  Sample sample;
 
-      input.encryption_scheme = widevine::Cdm::kAesCtr;
-      input.is_video = true;
-      input.block_offset = 0;
-      for (int ii = 15, counter = 0; ii >= 12; ii--, counter = counter >> 8) {
-          m_IV[ii] = counter & 0xFF;
+  while (m_asyncRunning == true) {
+    if (m_asyncQueue.Pop(sample) == true) {
+      if (m_audio == false) {
+        m_securePool.Wait();
       }
-
-      input.first_subsample = true;
-      input.last_subsample  = true;
-      if (widevine::Cdm::kSuccess == m_cdm->decrypt(input, output)) {
-        status = CDMi_SUCCESS;
+      const uint64_t start = DecryptMetrics::Now();
+      m_decryptLock.Lock();
+      m_metrics.Record(DecryptStatistics::STAGE_LOCK_WAIT, DecryptMetrics::Now() - start);
+      if (IsKeyUsable(sample.keyId, sample.keyIdLength) == true) {
+        sample.result = DecryptSample(sample);
       } else {
-        printf("CDM decrypt failed!\n");
+        m_metrics.Failed(DecryptStatistics::FAILURE_KEY_NOT_USABLE);
+        sample.token = nullptr;
+        sample.result = CDMi_S_FALSE;
+      }
+      m_decryptLock.Unlock();
+
+      m_asyncCallback->Decrypted(sample);
+    } else {
+      std::unique_lock<std::mutex> guard(m_asyncLock);
+      m_asyncWaiting = true;
+      while ((m_asyncRunning == true) && (m_asyncQueue.IsEmpty() == true)) {
+        m_asyncSignal.wait(guard);
       }
+      m_asyncWaiting = false;
     }
   }
 
-  //Copy and Return the Memory token in the incoming payload buffer.
-  *f_pcbOpaqueClearContent = sizeof(m_TokenHandle);
-  *f_ppbOpaqueClearContent = f_pbData;
-  memcpy(*f_ppbOpaqueClearContent,reinterpret_cast<uint8_t*>(&m_TokenHandle),sizeof(m_TokenHandle));
-
-  NEXUS_MemoryBlock_Unlock(pNexusMemoryBlock);
-  NEXUS_MemoryBlock_Free(pNexusMemoryBlock);
+  while (m_asyncQueue.Pop(sample) == true) {
+    sample.token = nullptr;
+    sample.result = CDMi_S_FALSE;
+    m_asyncCallback->Decrypted(sample);
+  }
 
-  g_lock.Unlock();
-  return status;
+  return nullptr;
 }
 
 CDMi_RESULT MediaKeySession::ReleaseClearContent(
@@ -426,6 +973,27 @@ CDMi_RESULT MediaKeySession::ReleaseClearContent(
     uint32_t f_cbSessionKey,
     const uint32_t  f_cbClearContentOpaque,
     uint8_t  *f_pbClearContentOpaque ){
+
+  // Audio comes back in the clear, there is no secure block to return. The
+  // consumer hands back what Decrypt gave it, which depends on the mode and
+  // not on the size of the buffer it passes.
+  if ((m_audio == false) && (f_pbClearContentOpaque != nullptr)) {
+    if (m_secureRegions == true) {
+      if (f_cbClearContentOpaque >= sizeof(SecureRegion)) {
+        SecureRegion region;
+        memcpy(&region, f_pbClearContentOpaque, sizeof(region));
+
+        // Hand the region back to the pool for the next sample.
+        m_securePool.Release(region.token, region.offset);
+      }
+    } else if (f_cbClearContentOpaque >= sizeof(NEXUS_MemoryBlockTokenHandle)) {
+      NEXUS_MemoryBlockTokenHandle token;
+      memcpy(&token, f_pbClearContentOpaque, sizeof(token));
+
+      // Hand the secure block back to the pool for the next sample.
+      m_securePool.Release(token, 0);
+    }
+  }
   return CDMi_SUCCESS;
 }
 }  // namespace CDMi
@@ -17,17 +17,37 @@
 
 #pragma once
 
+#include "AsyncDecrypt.h"
+#include "BatchDecrypt.h"
+#include "CountingLock.h"
+#include "DecryptStatistics.h"
+#include "InitData.h"
+#include "KeyTable.h"
+#include "SecureBufferPool.h"
+#include "SecureCopy.h"
+#include "SpscRing.h"
+#include "StagingBuffer.h"
+
 #include <cdm.h>
 #include <cdmi.h>
 
 #include <nexus_memory.h>
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 namespace CDMi
 {
-class MediaKeySession : public IMediaKeySession
+class MediaKeySession : public IMediaKeySession, public IBatchDecrypt, public IAsyncDecrypt
 {
+private:
+    static constexpr uint32_t AsyncQueueDepth = 64;
+
 public:
-    MediaKeySession(widevine::Cdm*, int32_t);
+    MediaKeySession(widevine::Cdm*, CountingLock&, KeyDirectory&, int32_t);
+    // Takes over an existing, licensed CDM session (see LicenseCache).
+    MediaKeySession(widevine::Cdm*, CountingLock&, KeyDirectory&, const std::string& sessionId);
     virtual ~MediaKeySession(void);
 
     virtual void Run(
@@ -57,6 +77,16 @@ public:
         const uint8_t *f_pbCDMData,
         uint32_t f_cbCDMData);
 
+    // Video output goes to secure memory, what the consumer gets back in
+    // f_ppbOpaqueClearContent, and returns through ReleaseClearContent, is
+    // agreed per session through the CDM data passed to Init:
+    //  - by default a bare NEXUS_MemoryBlockTokenHandle for a block of its
+    //    own, the output starts at the beginning of that block;
+    //  - with a "secure-region" parameter ("video/mp4; secure-region") a
+    //    SecureRegion, the output is length bytes at offset in the block
+    //    behind the token, which other samples share. Only such sessions
+    //    sub-allocate from the secure slab.
+    // Audio is returned in the clear, in place.
     virtual CDMi_RESULT Decrypt(
         const uint8_t *f_pbSessionKey,
         uint32_t f_cbSessionKey,
@@ -72,6 +102,48 @@ public:
         const uint8_t* keyId,
         bool initWithLast15);
 
+    // IBatchDecrypt
+    CDMi_RESULT DecryptBatch(std::vector<Sample>& samples) override;
+
+    // IAsyncDecrypt
+    CDMi_RESULT EnableAsync(IDecryptCallback* callback) override;
+    void DisableAsync() override;
+    CDMi_RESULT DecryptAsync(const Sample& sample) override;
+
+    inline const DecryptMetrics& Metrics() const {
+        return (m_metrics);
+    }
+
+    // Init data the license of this session can be found under again, empty
+    // if the license may not be cached.
+    inline void CacheKey(const std::string& key) {
+        m_cacheKey = key;
+    }
+    inline const std::string& CacheKey() const {
+        return (m_cacheKey);
+    }
+
+    inline bool IsAudio() const {
+        return (m_audio);
+    }
+
+    // The CDM instance the session lives on.
+    inline widevine::Cdm* Cdm() const {
+        return (m_cdm);
+    }
+
+    // A temporary session that obtained a license worth keeping.
+    bool IsReusable() const;
+
+    // Once destroyed by the client no more callbacks may reach it, although a
+    // CDM event that is being dispatched can still hold on to the session.
+    inline void Detach() {
+        m_detached = true;
+    }
+    inline bool IsDetached() const {
+        return (m_detached);
+    }
+
     virtual CDMi_RESULT ReleaseClearContent(
         const uint8_t *f_pbSessionKey,
         uint32_t f_cbSessionKey,
@@ -84,24 +156,77 @@ public:
     void onMessage(widevine::Cdm::MessageType f_messageType, const std::string& f_message);
     void onKeyStatusChange();
     void onRemoveComplete();
+    // Reports the keys whose status changed since the last call to the
+    // client, see KeyStatusNotifier.
+    void NotifyKeyStatuses();
     void onDeferredComplete(widevine::Cdm::Status);
     void onDirectIndividualizationRequest(const std::string&, const std::string&);
 
 private:
     void onKeyStatusError(widevine::Cdm::Status status);
+    const uint8_t* StageInput(const uint8_t* data, uint32_t length);
+    bool IsKeyUsable(const uint8_t* keyId, uint8_t keyIdLength);
+    CDMi_RESULT DecryptSample(Sample& sample);
+    bool DecryptSubSamples(
+        const uint8_t* source,
+        uint32_t length,
+        void* destination,
+        uint32_t destinationOffset,
+        const uint32_t* subSampleMapping,
+        uint32_t subSampleMappingCount,
+        const uint8_t* keyId,
+        uint8_t keyIdLength);
 
 private:
     widevine::Cdm *m_cdm;
+    // Shared by all sessions on m_cdm, only taken around license state changes.
+    CountingLock& m_cdmLock;
+    // Guards the decrypt state (IV, input buffer) of this session only.
+    CountingLock m_decryptLock;
     std::string m_CDMData;
     std::string m_initData;
     widevine::Cdm::InitDataType m_initDataType;
+    InitData m_initInfo;
+    // Audio skips the secure path, see Init.
+    bool m_audio;
+    // crypt:skip of cens and cbcs samples, see Init.
+    widevine::Cdm::Pattern m_pattern;
+    // The consumer takes SecureRegion descriptors, see Decrypt.
+    bool m_secureRegions;
+    // Descriptor of the last sample that was too short to hold it.
+    SecureRegion m_region;
+    // Ahead of the members reporting into it.
+    DecryptMetrics m_metrics;
+    KeyTable m_keyTable;
     widevine::Cdm::SessionType m_licenseType;
     std::string m_sessionId;
+    std::string m_cacheKey;
+    // Adopted a licensed CDM session, Run reports its keys instead of
+    // requesting a license.
+    bool m_restored;
     IMediaKeySessionCallback *m_piCallback;
+    // Guards m_piCallback and the key statuses as known to the CDM and as
+    // last told to the client.
+    std::mutex m_statusLock;
+    widevine::Cdm::KeyStatusMap m_latestStatuses;
+    widevine::Cdm::KeyStatusMap m_reportedStatuses;
+    std::atomic<bool> m_detached;
     uint8_t m_IV[16];
-    NEXUS_MemoryBlockTokenHandle m_TokenHandle;
-    void *m_pNexusMemory;
-    uint32_t m_NexusMemorySize;
+    SecureBufferPool m_securePool;
+    // Destroyed first, transfers into m_securePool blocks must be done.
+    SecureCopy m_secureCopy;
+    std::atomic<uint32_t> m_schemeSamples[InitData::PROTECTION_COUNT];
+
+    // Async decrypt worker, see RunThread.
+    IDecryptCallback* m_asyncCallback;
+    SpscRing<Sample, AsyncQueueDepth> m_asyncQueue;
+    std::thread m_asyncWorker;
+    std::atomic<bool> m_asyncRunning;
+    std::atomic<bool> m_asyncWaiting;
+    std::mutex m_asyncLock;
+    std::condition_variable m_asyncSignal;
+    // Heap input copied for the CDM, see StageInput.
+    StagingBuffer m_input;
 };
 
 }  // namespace CDMi
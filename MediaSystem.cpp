@@ -17,11 +17,23 @@
 
 #include "MediaSession.h"
 #include "HostImplementation.h"
-
+#include "CdmInstance.h"
+#include "KeyStatusNotifier.h"
+#include "LicenseCache.h"
+#include "SessionPool.h"
+#include "SessionRegistry.h"
+#include "StartupStatistics.h"
+
+#include <algorithm>
 #include <assert.h>
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <sys/utsname.h>
+#include <thread>
 #include <core/core.h>
 
 #include <nexus_config.h>
@@ -31,7 +43,7 @@ using namespace WPEFramework;
 
 namespace CDMi {
 
-class WideVine : public IMediaKeys, public widevine::Cdm::IEventListener
+class WideVine : public IMediaKeys, public IDecryptStatistics, public IStartupStatistics
 {
 private:
     WideVine (const WideVine&) = delete;
@@ -39,7 +51,10 @@ private:
 
     static constexpr char _certificateFilename[] = {"cert.bin"};
 
-    typedef std::map<std::string, MediaKeySession*> SessionMap;
+    static constexpr uint8_t MaximumCdmInstances = 8;
+
+    // Sessions created before the CDM is ready wait this long for it.
+    static constexpr uint32_t StartupTimeoutMs = 10000;
 
     class Config : public Core::JSON::Container {
     public:
@@ -52,12 +67,30 @@ private:
             , Company()
             , Model()
             , Device()
+            , Storage()
+            , StorageContainer()
+            , SessionPool()
+            , LicenseCache()
+            , InputBufferLimit()
+            , InFlightTokens()
+            , SecureSlab()
+            , SecureCopy()
+            , CdmInstances()
         {
             Add(_T("certificate"), &Certificate);
             Add(_T("product"), &Product);
             Add(_T("company"), &Company);
             Add(_T("model"), &Model);
             Add(_T("device"), &Device);
+            Add(_T("storage"), &Storage);
+            Add(_T("storagecontainer"), &StorageContainer);
+            Add(_T("sessionpool"), &SessionPool);
+            Add(_T("licensecache"), &LicenseCache);
+            Add(_T("inputbufferlimit"), &InputBufferLimit);
+            Add(_T("inflighttokens"), &InFlightTokens);
+            Add(_T("secureslab"), &SecureSlab);
+            Add(_T("securecopy"), &SecureCopy);
+            Add(_T("cdminstances"), &CdmInstances);
         }
         ~Config()
         {
@@ -69,106 +102,80 @@ private:
         Core::JSON::String Company;
         Core::JSON::String Model;
         Core::JSON::String Device;
+        Core::JSON::String Storage;
+        Core::JSON::Boolean StorageContainer;
+        Core::JSON::DecUInt8 SessionPool;
+        Core::JSON::DecUInt8 LicenseCache;
+        Core::JSON::DecUInt32 InputBufferLimit;
+        Core::JSON::DecUInt8 InFlightTokens;
+        Core::JSON::DecUInt32 SecureSlab;
+        Core::JSON::Boolean SecureCopy;
+        Core::JSON::DecUInt8 CdmInstances;
     };
 
 
 public:
     WideVine()
-        : _adminLock()
-        , _cdm(nullptr)
+        : _config()
         , _host()
-        , _sessions() {
+        , _sessions()
+        , _notifier()
+        , _retired()
+        , _instances()
+        , _startupLock()
+        , _started()
+        , _startupStatistics()
+        , _startup() {
   
     }
 
     ~WideVine() override {
-        _adminLock.Lock();
-
-        SessionMap::iterator index (_sessions.begin());
-
-        while  (index != _sessions.end()) {
-            delete index->second;
-            index++;
+        if (_startup.joinable() == true) {
+            _startup.join();
         }
 
-        _sessions.clear();
-
-        _adminLock.Unlock();
-
-        if (_cdm != nullptr) {
-            delete _cdm;
+        _notifier.Stop();
+        for (std::unique_ptr<CdmInstance>& instance : _instances) {
+            instance->Pool().Stop();
         }
+        _sessions.Clear();
+        _instances.clear();
+
+        TRACE_L1(_T("Key status changes coalesced into %u of %u notifications"), _notifier.Delivered(), _notifier.Scheduled());
     }
 
     void Initialize(const WPEFramework::PluginHost::IShell * shell, const std::string& configline)
     {
-        NxClient_JoinSettings joinSettings;
-        NEXUS_Error rc;
-        NxClient_GetDefaultJoinSettings(&joinSettings);
-        snprintf(joinSettings.name, NXCLIENT_MAX_NAME, "widevine");
-        rc = NxClient_Join(&joinSettings);
-        assert (rc == 0);
-        DEBUG_VARIABLE(rc);
-        widevine::Cdm::ClientInfo client_info;
+        const uint64_t start = DecryptMetrics::Now();
 
-        Config config;
-        config.FromString(configline);
+        _config.FromString(configline);
 
-        // Set client info that denotes this as the test suite:
-        if (config.Product.IsSet() == true) {
-            client_info.product_name = config.Product.Value();
-        } else {
-            client_info.product_name = "WPEFramework";
-        }
-        
-        if (config.Company.IsSet() == true) {
-            client_info.company_name = config.Company.Value();
-        } else {
-            client_info.company_name = "www.metrological.com";
+        // Bytes of Nexus memory a session may stage heap input in.
+        if (_config.InputBufferLimit.IsSet() == true) {
+            StagingBuffer::Limit(_config.InputBufferLimit.Value());
         }
 
-        if (config.Model.IsSet() == true) {
-            client_info.model_name = config.Model.Value();
-        } else {
-            client_info.model_name = "reference";
+        // Decoded frames a client may hold before Decrypt waits for one.
+        if (_config.InFlightTokens.IsSet() == true) {
+            SecureBufferPool::InFlightLimit(_config.InFlightTokens.Value());
         }
 
-#if defined(__linux__)
-        if (config.Device.IsSet() == true) {
-            client_info.device_name = config.Device.Value();
-        } else {
-            client_info.device_name = "Linux";
+        // Secure memory a video session reserves to carve its samples out of.
+        if (_config.SecureSlab.IsSet() == true) {
+            SecureSlab::Reserve(_config.SecureSlab.Value());
         }
 
-        {
-            struct utsname name;
-            if (!uname(&name)) {
-                client_info.arch_name = name.machine;
-            }
+        // Clear ranges go to secure memory by DMA unless switched off here.
+        if (_config.SecureCopy.IsSet() == true) {
+            SecureCopy::Enable(_config.SecureCopy.Value());
         }
-#else
-        client_info.device_name = "Unknown";
-#endif
-        client_info.build_info = __DATE__;
-
-        // widevine::Cdm::DeviceCertificateRequest cert_request;
 
-        if (config.Certificate.IsSet() == true) {
-            Core::DataElementFile dataBuffer(config.Certificate.Value(), Core::File::USER_READ);
+        // Joining Nexus, reading the certificate and creating the CDM are
+        // left to a thread, so the plugin registers right away. Sessions
+        // created before the CDM is ready wait for it.
+        _startup = std::thread(&WideVine::Startup, this, start);
 
-            if(dataBuffer.IsValid() == false) {
-                TRACE_L1(_T("Failed to open %s"), config.Certificate.Value().c_str());
-            } else {
-                _host.PreloadFile(_certificateFilename,  std::string(reinterpret_cast<const char*>(dataBuffer.Buffer()), dataBuffer.Size()));
-            }
-        }
-
-        if (widevine::Cdm::kSuccess == widevine::Cdm::initialize(
-                widevine::Cdm::kOpaqueHandle, client_info, &_host, &_host, &_host, static_cast<widevine::Cdm::LogLevel>(-1))) {
-	    // Setting the last parameter to true, requres serviceCertificates so the requests can be encrypted. Currently badly supported
-            // in the EME tests, so turn of for now :-)
-            _cdm = widevine::Cdm::create(this, &_host, false);
-        }     
+        Completed(StartupStatistics::PHASE_REGISTER, start);
     }
 
     CDMi_RESULT CreateMediaKeySession(
@@ -184,7 +191,45 @@ public:
         CDMi_RESULT dr = CDMi_S_FALSE;
         *f_ppiMediaKeySession = nullptr;
 
-        MediaKeySession* mediaKeySession = new MediaKeySession(_cdm, licenseType);
+        if ((WaitForStartup() == false) || (_instances.empty() == true)) {
+            return (dr);
+        }
+
+        CdmInstance* instance = LeastLoaded();
+        MediaKeySession* prepared = nullptr;
+        std::string cacheKey;
+        bool restored = false;
+
+        if ((licenseType != PersistentUsageRecord) && (licenseType != PersistentLicense)) {
+            if (instance->Cache().IsEnabled() == true) {
+                cacheKey = LicenseCache::Key(f_pwszInitDataType, f_pbInitData, f_cbInitData);
+
+                // The license stays on the instance it was parked on.
+                for (uint8_t index = 0; (prepared == nullptr) && (index < _instances.size()); index++) {
+                    const std::string parked (_instances[index]->Cache().Take(cacheKey));
+                    if (parked.empty() == false) {
+                        instance = _instances[index].get();
+                        prepared = new MediaKeySession(instance->Cdm(), instance->Lock(), instance->Keys(), parked);
+                        restored = true;
+                    }
+                }
+            }
+            if (prepared == nullptr) {
+                prepared = instance->Pool().Take();
+            }
+            // A session prepared on another instance still beats creating one.
+            for (uint8_t index = 0; (prepared == nullptr) && (index < _instances.size()); index++) {
+                if (_instances[index].get() != instance) {
+                    prepared = _instances[index]->Pool().Take();
+                    if (prepared != nullptr) {
+                        instance = _instances[index].get();
+                    }
+                }
+            }
+        }
+
+        SessionRegistry::Session mediaKeySession(prepared != nullptr ? prepared :
+            new MediaKeySession(instance->Cdm(), instance->Lock(), instance->Keys(), licenseType));
 
         dr = mediaKeySession->Init(licenseType,
             f_pwszInitDataType,
@@ -193,36 +238,59 @@ public:
             f_pbCDMData,
             f_cbCDMData);
 
+        mediaKeySession->CacheKey(cacheKey);
 
-        if (dr != CDMi_SUCCESS) {
-            delete mediaKeySession;
+        const std::string sessionId (mediaKeySession->GetSessionId());
+
+        if (dr == CDMi_SUCCESS) {
+            if (_sessions.Insert(sessionId, mediaKeySession) == true) {
+                instance->AddSession();
+                *f_ppiMediaKeySession = mediaKeySession.get();
+            } else {
+                dr = CDMi_S_FALSE;
+            }
         }
-        else {
-            std::string sessionId (mediaKeySession->GetSessionId());
-            _sessions.insert(std::pair<std::string, MediaKeySession*>(sessionId, mediaKeySession));
-            *f_ppiMediaKeySession = mediaKeySession;
+
+        // Nobody else knows the session, so what it holds in the CDM is
+        // handed back here: a license taken from the cache goes back to it,
+        // anything else is closed. Unless the CDM gave out an id that a live
+        // session already uses, closing that would end the live one.
+        if (dr != CDMi_SUCCESS) {
+            TRACE_L1(_T("Could not create session %s"), sessionId.c_str());
+            if (((restored == false) || (instance->Cache().Park(cacheKey, sessionId) == false)) &&
+                (_sessions.Find(sessionId) == nullptr)) {
+                mediaKeySession->Close();
+            }
         }
 
         return dr;
     }
 
+
     CDMi_RESULT SetServerCertificate(
         const uint8_t *f_pbServerCertificate,
         uint32_t f_cbServerCertificate) override {
 
-        CDMi_RESULT dr = CDMi_S_FALSE;
+        CDMi_RESULT dr = CDMi_SUCCESS;
+
+        // The instances are not to be touched until the startup thread is done.
+        if ((WaitForStartup() == false) || (_instances.empty() == true)) {
+            return (CDMi_S_FALSE);
+        }
 
         std::string serverCertificate(reinterpret_cast<const char*>(f_pbServerCertificate), f_cbServerCertificate);
 
+        for (std::unique_ptr<CdmInstance>& instance : _instances) {
 #ifdef USE_CENC15
-        if (widevine::Cdm::kSuccess == _cdm->setServiceCertificate(widevine::Cdm::ServiceRole::kAllServices, serverCertificate)) {
-            dr = CDMi_SUCCESS;
-        }
+            if (widevine::Cdm::kSuccess != instance->Cdm()->setServiceCertificate(widevine::Cdm::ServiceRole::kAllServices, serverCertificate)) {
+                dr = CDMi_S_FALSE;
+            }
 #else
-        if (widevine::Cdm::kSuccess == _cdm->setServiceCertificate(serverCertificate)) {
-            dr = CDMi_SUCCESS;
-        }
+            if (widevine::Cdm::kSuccess != instance->Cdm()->setServiceCertificate(serverCertificate)) {
+                dr = CDMi_S_FALSE;
+            }
 #endif   
+        }
         return dr;
     }
 
@@ -231,96 +299,272 @@ public:
 
         std::string sessionId (f_piMediaKeySession->GetSessionId());
 
-        _adminLock.Lock();
+        SessionRegistry::Session session (_sessions.Remove(sessionId));
 
-        SessionMap::iterator index (_sessions.find(sessionId));
+        if (session) {
+            CdmInstance* instance = Owner(*session);
 
-        if (index != _sessions.end()) {
-            // To clean up an underlying session resource, 
-            //  otherwise the session limit(eg,50) will hit eventually
-            index->second->Close();
-            _sessions.erase(index);
+            // A licensed temporary session is parked for a quick return to
+            // the same content, anything else is closed to clean up the
+            // underlying session resource, otherwise the session limit
+            // (eg,50) will hit eventually.
+            if ((session->IsReusable() == false) || (instance == nullptr) ||
+                (instance->Cache().Park(session->CacheKey(), sessionId) == false)) {
+                session->Close();
+            }
+            if (instance != nullptr) {
+                instance->RemoveSession();
+            }
+            // Keep the numbers of the session in the totals.
+            _retired.Retire(session->Metrics());
+            // Freed here, or by the dispatch in progress if the client
+            // destroys the session from one of its callbacks.
+            session.reset();
+        } else {
+            delete f_piMediaKeySession;
         }
 
-        _adminLock.Unlock();
-
-        delete f_piMediaKeySession;
-
         return CDMi_SUCCESS;
     }
 
-    void onMessage(const std::string& session_id,
-        widevine::Cdm::MessageType f_messageType,
-        const std::string& f_message) override {
+    void Statistics(DecryptStatistics& statistics) const override {
+        DecryptMetrics total;
+
+        total.Add(_retired);
+        _sessions.ForEach([&total](const MediaKeySession& session) {
+            total.Add(session.Metrics());
+        });
 
-        _adminLock.Lock();
+        total.Get(statistics);
+    }
 
-        SessionMap::iterator index (_sessions.find(session_id));
+    bool Statistics(const std::string& sessionId, DecryptStatistics& statistics) const override {
+        SessionRegistry::Session session (_sessions.Find(sessionId));
 
-        if (index != _sessions.end()) index->second->onMessage(f_messageType, f_message);
+        if (session) {
+            session->Metrics().Get(statistics);
+        }
 
-        _adminLock.Unlock();
+        return (static_cast<bool>(session));
     }
 
-#if defined (USE_CENC14) || defined (USE_CENC15)
-    void onKeyStatusesChange(const std::string& session_id,  bool has_new_usable_key) override
-#else
-    void onKeyStatusesChange(const std::string& session_id) override
-#endif    
+    void Statistics(StartupStatistics& statistics) const override {
+        std::lock_guard<std::mutex> guard(_startupLock);
+        statistics = _startupStatistics;
+    }
+
+private:
+    void Startup(const uint64_t start)
     {
+        const Config& config (_config);
+        uint64_t stamp = DecryptMetrics::Now();
 
-        _adminLock.Lock();
+        NxClient_JoinSettings joinSettings;
+        NEXUS_Error rc;
+        NxClient_GetDefaultJoinSettings(&joinSettings);
+        snprintf(joinSettings.name, NXCLIENT_MAX_NAME, "widevine");
+        rc = NxClient_Join(&joinSettings);
+        assert (rc == 0);
+        DEBUG_VARIABLE(rc);
+        stamp = Completed(StartupStatistics::PHASE_JOIN, stamp);
+
+        widevine::Cdm::ClientInfo client_info;
+
+        // Set client info that denotes this as the test suite:
+        if (config.Product.IsSet() == true) {
+            client_info.product_name = config.Product.Value();
+        } else {
+            client_info.product_name = "WPEFramework";
+        }
+        
+        if (config.Company.IsSet() == true) {
+            client_info.company_name = config.Company.Value();
+        } else {
+            client_info.company_name = "www.metrological.com";
+        }
 
-        SessionMap::iterator index (_sessions.find(session_id));
+        if (config.Model.IsSet() == true) {
+            client_info.model_name = config.Model.Value();
+        } else {
+            client_info.model_name = "reference";
+        }
 
-        if (index != _sessions.end()) index->second->onKeyStatusChange();
+#if defined(__linux__)
+        if (config.Device.IsSet() == true) {
+            client_info.device_name = config.Device.Value();
+        } else {
+            client_info.device_name = "Linux";
+        }
 
-        _adminLock.Unlock();
-    }
+        {
+            struct utsname name;
+            if (!uname(&name)) {
+                client_info.arch_name = name.machine;
+            }
+        }
+#else
+        client_info.device_name = "Unknown";
+#endif
+        client_info.build_info = __DATE__;
 
-    void onRemoveComplete(const std::string& session_id) override {
+        // widevine::Cdm::DeviceCertificateRequest cert_request;
 
-        _adminLock.Lock();
+        // Licenses, usage records and provisioning survive a restart only if
+        // a storage directory is configured.
+        if (config.Storage.IsSet() == true) {
+            if (_host.Initialize(config.Storage.Value(), (config.StorageContainer.IsSet() == true) && (config.StorageContainer.Value() == true)) == false) {
+                TRACE_L1(_T("Failed to use storage %s"), config.Storage.Value().c_str());
+            }
+        }
+        stamp = Completed(StartupStatistics::PHASE_STORAGE, stamp);
 
-        SessionMap::iterator index (_sessions.find(session_id));
+        if (config.Certificate.IsSet() == true) {
+            Core::DataElementFile dataBuffer(config.Certificate.Value(), Core::File::USER_READ);
 
-        if (index != _sessions.end()) index->second->onRemoveComplete();
+            if(dataBuffer.IsValid() == false) {
+                TRACE_L1(_T("Failed to open %s"), config.Certificate.Value().c_str());
+            } else {
+                _host.PreloadFile(_certificateFilename,  std::string(reinterpret_cast<const char*>(dataBuffer.Buffer()), dataBuffer.Size()));
+            }
+        }
+        stamp = Completed(StartupStatistics::PHASE_CERTIFICATE, stamp);
+
+        const bool initialized = (widevine::Cdm::kSuccess == widevine::Cdm::initialize(
+                widevine::Cdm::kOpaqueHandle, client_info, &_host, &_host, &_host, static_cast<widevine::Cdm::LogLevel>(-1)));
+        stamp = Completed(StartupStatistics::PHASE_INITIALIZE, stamp);
+
+        if (initialized == true) {
+            // Sessions are spread over the instances, so streams playing at
+            // the same time (PiP, mosaic, multi-audio) are not serialized
+            // inside a single CDM. Keys only route between sessions on the
+            // same instance, see KeyDirectory.
+            uint8_t count = 1;
+            if (config.CdmInstances.IsSet() == true) {
+                count = std::max<uint8_t>(1, std::min(config.CdmInstances.Value(), MaximumCdmInstances));
+            }
+            for (uint8_t index = 0; index < count; index++) {
+                std::unique_ptr<CdmInstance> instance(new CdmInstance(_sessions, _notifier));
+                if (instance->Open(_host) == false) {
+                    TRACE_L1(_T("Created %u of %u CDM instances"), index, count);
+                    break;
+                }
+                _instances.push_back(std::move(instance));
+            }
+        }
+        stamp = Completed(StartupStatistics::PHASE_CREATE, stamp);
+
+        // Key status changes reach the clients from here, not the CDM thread.
+        if (_instances.empty() == false) {
+            _notifier.Start([this](const std::string& sessionId) {
+                _sessions.Dispatch(sessionId, [](MediaKeySession& session) {
+                    session.NotifyKeyStatuses();
+                });
+            });
+        }
 
-        _adminLock.Unlock();
-    }
+        // Temporary sessions prepared ahead of the next channel change,
+        // spread over the instances.
+        if (config.SessionPool.IsSet() == true) {
+            const uint8_t size = config.SessionPool.Value();
+            for (uint8_t index = 0; index < _instances.size(); index++) {
+                const uint8_t share = (size / _instances.size()) + (index < (size % _instances.size()) ? 1 : 0);
+                if (share != 0) {
+                    CdmInstance& instance (*_instances[index]);
+                    instance.Pool().Start(instance.Cdm(), instance.Lock(), instance.Keys(), share);
+                }
+            }
+        }
 
-    // Called when a deferred action has completed.
-    void onDeferredComplete(const std::string& session_id, widevine::Cdm::Status result) override {
+        // Licenses of recently closed temporary sessions, for re-entering the
+        // same content without a license round-trip. A session is parked on
+        // its own instance, the capacity applies per instance.
+        if (config.LicenseCache.IsSet() == true) {
+            for (std::unique_ptr<CdmInstance>& instance : _instances) {
+                instance->Cache().Configure(instance->Cdm(), instance->Lock(), _host, config.LicenseCache.Value());
+            }
+        }
 
-        _adminLock.Lock();
+        const uint64_t total = DecryptMetrics::Now() - start;
+        {
+            std::lock_guard<std::mutex> guard(_startupLock);
+            _startupStatistics.ready = true;
+            _startupStatistics.total = total;
+        }
+        _started.notify_all();
 
-        SessionMap::iterator index (_sessions.find(session_id));
+        TRACE_L1(_T("CDM ready after %llu ms"), static_cast<unsigned long long>(total / 1000000));
+    }
 
-        if (index != _sessions.end()) index->second->onDeferredComplete(result);
+    // Records the phase that began at stamp, returns its end.
+    uint64_t Completed(StartupStatistics::Phase phase, const uint64_t stamp)
+    {
+        const uint64_t now = DecryptMetrics::Now();
 
-        _adminLock.Unlock();
+        std::lock_guard<std::mutex> guard(_startupLock);
+        _startupStatistics.phases[phase] = now - stamp;
+        return (now);
     }
 
-    // Called when the CDM requires a new device certificate
-    virtual void onDirectIndividualizationRequest(const std::string& session_id, const std::string& request) {
+    // False if the CDM did not come up in time.
+    bool WaitForStartup()
+    {
+        std::unique_lock<std::mutex> guard(_startupLock);
+
+        if (_startupStatistics.ready == false) {
+            const uint64_t start = DecryptMetrics::Now();
 
-        _adminLock.Lock();
+            _started.wait_for(guard, std::chrono::milliseconds(StartupTimeoutMs), [this]() {
+                return (_startupStatistics.ready);
+            });
 
-        SessionMap::iterator index (_sessions.find(session_id));
+            const uint64_t waited = DecryptMetrics::Now() - start;
+            _startupStatistics.waits++;
+            _startupStatistics.waited = std::max(_startupStatistics.waited, waited);
+        }
+
+        return (_startupStatistics.ready);
+    }
 
-        if (index != _sessions.end()) index->second->onDirectIndividualizationRequest(session_id, request);
+    CdmInstance* LeastLoaded() {
+        CdmInstance* result = _instances.front().get();
+        for (std::unique_ptr<CdmInstance>& instance : _instances) {
+            if (instance->Sessions() < result->Sessions()) {
+                result = instance.get();
+            }
+        }
+        return (result);
+    }
 
-        _adminLock.Unlock();
+    CdmInstance* Owner(const MediaKeySession& session) {
+        for (std::unique_ptr<CdmInstance>& instance : _instances) {
+            if (instance->Cdm() == session.Cdm()) {
+                return (instance.get());
+            }
+        }
+        return (nullptr);
     }
 
 private:
-    WPEFramework::Core::CriticalSection _adminLock;
-    widevine::Cdm* _cdm;
+    // Read by the startup thread, Initialize does not touch it once started.
+    Config _config;
     HostImplementation _host;
-    SessionMap _sessions;
+    SessionRegistry _sessions;
+    KeyStatusNotifier _notifier;
+    // Decrypt statistics of the sessions destroyed so far.
+    DecryptMetrics _retired;
+    // Destroyed ahead of the registry and notifier they dispatch to.
+    std::vector<std::unique_ptr<CdmInstance>> _instances;
+    // Guards _startupStatistics, the instances are set up by _startup
+    // before it reports ready and left alone from then on.
+    mutable std::mutex _startupLock;
+    std::condition_variable _started;
+    StartupStatistics _startupStatistics;
+    std::thread _startup;
 };
 
 constexpr char WideVine::_certificateFilename[];
+constexpr uint8_t WideVine::MaximumCdmInstances;
+constexpr uint32_t WideVine::StartupTimeoutMs;
 
 static SystemFactoryType<WideVine> g_instance({"video/webm", "video/mp4", "audio/webm", "audio/mp4"});
 
@@ -0,0 +1,118 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+
+namespace CDMi {
+
+// Pointer to an immutable object that readers follow without taking a lock.
+// A writer publishes a replacement and frees the previous object once the
+// readers that may still see it are gone. Readers announce themselves in the
+// slot of the current epoch and retry if it moved on in the meantime, so a
+// writer only has to wait for the slot it just retired. Writers must be
+// serialized by the owner.
+template <typename OBJECT>
+class RcuPointer {
+public:
+  class ReadGuard {
+  public:
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+
+    explicit ReadGuard(const RcuPointer& parent)
+      : _parent(parent)
+      , _slot(parent.Enter())
+      , _object(parent._object.load()) {
+    }
+    ~ReadGuard() {
+      _parent.Leave(_slot);
+    }
+
+  public:
+    inline const OBJECT& operator*() const {
+      return (*_object);
+    }
+    inline const OBJECT* operator->() const {
+      return (_object);
+    }
+
+  private:
+    const RcuPointer& _parent;
+    const uint32_t _slot;
+    const OBJECT* _object;
+  };
+
+public:
+  RcuPointer(const RcuPointer&) = delete;
+  RcuPointer& operator=(const RcuPointer&) = delete;
+
+  explicit RcuPointer(OBJECT* object)
+    : _object(object)
+    , _epoch(0) {
+    _readers[0] = 0;
+    _readers[1] = 0;
+  }
+  ~RcuPointer() {
+    delete _object.load();
+  }
+
+public:
+  // Writer side only.
+  inline const OBJECT& Current() const {
+    return (*_object.load());
+  }
+
+  void Publish(OBJECT* object) {
+    const OBJECT* old = _object.exchange(object);
+    const uint32_t epoch = _epoch.fetch_add(1);
+
+    while (_readers[epoch & 1].load() != 0) {
+      std::this_thread::yield();
+    }
+
+    delete old;
+  }
+
+private:
+  uint32_t Enter() const {
+    while (true) {
+      const uint32_t epoch = _epoch.load();
+      _readers[epoch & 1].fetch_add(1);
+      if (_epoch.load() == epoch) {
+        return (epoch & 1);
+      }
+      _readers[epoch & 1].fetch_sub(1);
+    }
+  }
+  void Leave(uint32_t slot) const {
+    _readers[slot].fetch_sub(1);
+  }
+
+private:
+  std::atomic<OBJECT*> _object;
+  std::atomic<uint32_t> _epoch;
+  mutable std::atomic<uint32_t> _readers[2];
+};
+
+}  // namespace CDMi
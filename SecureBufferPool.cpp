@@ -0,0 +1,319 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SecureBufferPool.h"
+
+#include <stdio.h>
+
+namespace CDMi {
+
+constexpr uint8_t SecureBufferPool::MinimumClassShift;
+constexpr uint8_t SecureBufferPool::MaximumClassShift;
+constexpr uint8_t SecureBufferPool::ClassCount;
+constexpr uint8_t SecureBufferPool::MaximumIdlePerClass;
+constexpr uint8_t SecureBufferPool::RingSize;
+constexpr uint8_t SecureBufferPool::DefaultInFlight;
+constexpr uint32_t SecureBufferPool::BackpressureTimeoutMs;
+constexpr uint8_t SecureBufferPool::NoSlab;
+
+/* static */ std::atomic<uint8_t> SecureBufferPool::_limit(0);
+
+SecureBufferPool::SecureBufferPool(DecryptMetrics& metrics)
+  : _metrics(metrics)
+  , _adminLock()
+  , _released()
+  , _heap(NEXUS_Heap_Lookup(NEXUS_HeapLookupType_eCompressedRegion))
+  , _idle()
+  , _slab(metrics)
+  , _spare()
+  , _abandoned()
+  , _head(0)
+  , _tail(0)
+  , _inFlight(0)
+  , _allocations(0)
+  , _releasing(true) {
+
+  for (uint8_t index = 0; index < ClassCount; index++) {
+    _idle[index].reserve(MaximumIdlePerClass);
+  }
+  for (Buffer*& slot : _ring) {
+    slot = nullptr;
+  }
+  _abandoned.reserve(RingSize);
+}
+
+SecureBufferPool::~SecureBufferPool() {
+  for (uint8_t index = 0; index < ClassCount; index++) {
+    for (Buffer* buffer : _idle[index]) {
+      Destroy(buffer);
+    }
+  }
+  for (Buffer* buffer : _ring) {
+    if (buffer != nullptr) {
+      Destroy(buffer);
+    }
+  }
+  for (Buffer* buffer : _spare) {
+    delete buffer;
+  }
+  for (Buffer* buffer : _abandoned) {
+    delete buffer;
+  }
+}
+
+/* static */ void SecureBufferPool::InFlightLimit(uint8_t tokens) {
+  _limit = (tokens > RingSize ? RingSize : tokens);
+}
+
+/* static */ uint8_t SecureBufferPool::SizeClass(uint32_t size) {
+  uint8_t shift = MinimumClassShift;
+  while ((shift <= MaximumClassShift) && ((1u << shift) < size)) {
+    shift++;
+  }
+  return (shift - MinimumClassShift);
+}
+
+bool SecureBufferPool::Reserve() {
+  std::lock_guard<std::mutex> guard(_adminLock);
+  return (_slab.Open());
+}
+
+const SecureBufferPool::Buffer* SecureBufferPool::Acquire(uint32_t size) {
+  Buffer* result = nullptr;
+  const uint8_t sizeClass = SizeClass(size);
+
+  std::lock_guard<std::mutex> guard(_adminLock);
+
+  Admit();
+
+  // A region is only carved for a consumer that hands tokens back, the
+  // others get blocks they can keep.
+  if ((_slab.IsOpen() == true) && (_releasing == true)) {
+    result = Carve(size);
+    if (result == nullptr) {
+      _metrics.SlabFallback();
+    }
+  }
+
+  if (result == nullptr) {
+    if ((sizeClass < ClassCount) && (_idle[sizeClass].empty() == false)) {
+      result = _idle[sizeClass].back();
+      _idle[sizeClass].pop_back();
+    } else {
+      result = Allocate(sizeClass < ClassCount ? (1u << (sizeClass + MinimumClassShift)) : size);
+    }
+  }
+
+  if (result != nullptr) {
+    result->length = size;
+    result->token = NEXUS_MemoryBlock_CreateToken(result->block);
+    if (result->token == nullptr) {
+      printf("Could not create a token for another process\n");
+      Recycle(result);
+      result = nullptr;
+    } else {
+      _ring[_tail % RingSize] = result;
+      _tail++;
+      _inFlight++;
+    }
+  }
+
+  return result;
+}
+
+bool SecureBufferPool::Release(NEXUS_MemoryBlockTokenHandle token, uint32_t offset) {
+  bool found = false;
+
+  {
+    std::lock_guard<std::mutex> guard(_adminLock);
+
+    // Tokens mostly come back in order, the match is usually at the head.
+    for (uint32_t position = _head; position != _tail; position++) {
+      Buffer*& slot(_ring[position % RingSize]);
+      if ((slot != nullptr) && (slot->token == token) && (slot->offset == offset)) {
+        Recycle(slot);
+        slot = nullptr;
+        _inFlight--;
+        _releasing = true;
+        found = true;
+        break;
+      }
+    }
+
+    // Late for a region that was given up on, it is free for reuse now.
+    for (std::vector<Buffer*>::iterator index = _abandoned.begin(); (found == false) && (index != _abandoned.end()); index++) {
+      if (((*index)->token == token) && ((*index)->offset == offset)) {
+        Recycle(*index);
+        _abandoned.erase(index);
+        _releasing = true;
+        found = true;
+        break;
+      }
+    }
+
+    Advance();
+  }
+
+  if (found == true) {
+    _released.notify_one();
+  }
+
+  return found;
+}
+
+void SecureBufferPool::Wait() {
+  const uint8_t limit = _limit;
+
+  if ((limit != 0) && (_inFlight >= limit)) {
+    std::unique_lock<std::mutex> guard(_adminLock);
+
+    // Waiting for a consumer that never releases would throttle playback to
+    // the timeout.
+    if ((_inFlight >= limit) && (_releasing == true)) {
+      const uint64_t start = DecryptMetrics::Now();
+      if (_released.wait_for(guard, std::chrono::milliseconds(BackpressureTimeoutMs), [this, limit]() {
+            return (_inFlight < limit);
+          }) == false) {
+        _releasing = false;
+      }
+      _metrics.Record(DecryptStatistics::STAGE_BACKPRESSURE, DecryptMetrics::Now() - start);
+    }
+  }
+}
+
+// Called with the lock held, makes room in the ring for one more token. Some
+// other decrypt may have taken the room Wait made, the oldest token goes.
+void SecureBufferPool::Admit() {
+  const uint8_t limit = _limit;
+  const uint8_t depth = (limit != 0 ? limit : DefaultInFlight);
+  while ((_inFlight >= depth) || ((_tail - _head) == RingSize)) {
+    Abandon();
+  }
+}
+
+// The oldest consumer never handed its token back; let go of our reference
+// instead of recycling a block that may still be in use.
+void SecureBufferPool::Abandon() {
+  Buffer*& slot(_ring[_head % RingSize]);
+
+  if (slot->slab != NoSlab) {
+    // The region cannot be handed over, keep it until the token comes back.
+    if (_abandoned.size() == RingSize) {
+      Destroy(_abandoned.front());
+      _abandoned.erase(_abandoned.begin());
+    }
+    _abandoned.push_back(slot);
+  } else {
+    Destroy(slot);
+  }
+  slot = nullptr;
+  _releasing = false;
+  _inFlight--;
+  _metrics.Abandoned();
+
+  Advance();
+}
+
+// Moves the head past returned tokens.
+void SecureBufferPool::Advance() {
+  while ((_head != _tail) && (_ring[_head % RingSize] == nullptr)) {
+    _head++;
+  }
+}
+
+SecureBufferPool::Buffer* SecureBufferPool::Carve(uint32_t size) {
+  Buffer* result = nullptr;
+  SecureSlab::Region region;
+
+  if (_slab.Allocate(size, region) == true) {
+    if (_spare.empty() == false) {
+      result = _spare.back();
+      _spare.pop_back();
+    } else {
+      result = new Buffer;
+    }
+    result->block = region.block;
+    result->opaque = region.opaque;
+    result->offset = region.offset;
+    result->capacity = region.capacity;
+    result->slab = region.index;
+    result->token = nullptr;
+  }
+
+  return result;
+}
+
+SecureBufferPool::Buffer* SecureBufferPool::Allocate(uint32_t capacity) {
+  Buffer* result = nullptr;
+
+  NEXUS_MemoryBlockHandle block = NEXUS_MemoryBlock_Allocate(_heap, capacity, 0, nullptr);
+  if (block == nullptr) {
+    printf("NexusBlockMemory could not allocate %d\n", capacity);
+  } else {
+    void* opaque = nullptr;
+    if (NEXUS_MemoryBlock_Lock(block, &opaque) != 0) {
+      printf("NexusBlockMemory is not usable\n");
+      NEXUS_MemoryBlock_Free(block);
+    } else {
+      result = new Buffer;
+      result->block = block;
+      result->opaque = opaque;
+      result->offset = 0;
+      result->capacity = capacity;
+      result->length = 0;
+      result->slab = NoSlab;
+      result->token = nullptr;
+      _allocations++;
+    }
+  }
+
+  return result;
+}
+
+void SecureBufferPool::Recycle(Buffer* buffer) {
+  const uint8_t sizeClass = SizeClass(buffer->capacity);
+
+  buffer->token = nullptr;
+
+  if (buffer->slab != NoSlab) {
+    SecureSlab::Region region;
+    region.block = buffer->block;
+    region.opaque = buffer->opaque;
+    region.offset = buffer->offset;
+    region.capacity = buffer->capacity;
+    region.index = buffer->slab;
+    _slab.Free(region, buffer->length);
+    _spare.push_back(buffer);
+  } else if ((sizeClass < ClassCount) && (_idle[sizeClass].size() < MaximumIdlePerClass)) {
+    _idle[sizeClass].push_back(buffer);
+  } else {
+    Destroy(buffer);
+  }
+}
+
+void SecureBufferPool::Destroy(Buffer* buffer) {
+  // A slab region stays allocated, the consumer may still be reading it.
+  if (buffer->slab == NoSlab) {
+    NEXUS_MemoryBlock_Unlock(buffer->block);
+    NEXUS_MemoryBlock_Free(buffer->block);
+  }
+  delete buffer;
+}
+
+}  // namespace CDMi
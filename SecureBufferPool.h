@@ -0,0 +1,156 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "DecryptStatistics.h"
+#include "SecureSlab.h"
+
+#include <nexus_memory.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace CDMi {
+
+// Keeps secure (compressed region) memory blocks around between decrypts so
+// the hot path does not allocate, lock and free a Nexus block per sample.
+// Blocks are handed out with a fresh token and only become reusable once the
+// consumer returned the token through Release(). Outstanding tokens are kept
+// in a ring in hand-out order; with a limit configured, Wait holds the
+// decrypt back while the consumer sits on that many tokens instead of
+// allocating more of the secure heap. A consumer that lets a wait run out,
+// or a token go stale, is taken to not release at all; from then on the
+// oldest token is dropped right away instead and no slab regions are handed
+// out, until a token comes back again. A dropped slab region is only reused
+// once its token does come back.
+class SecureBufferPool {
+public:
+  struct Buffer {
+    NEXUS_MemoryBlockHandle block;
+    void* opaque;
+    // Region of the block that is the output, the whole block unless it was
+    // carved out of the slab.
+    uint32_t offset;
+    uint32_t capacity;
+    uint32_t length;
+    uint8_t slab;
+    NEXUS_MemoryBlockTokenHandle token;
+  };
+
+private:
+  // Blocks are rounded up to a power of two between 4 KB and 16 MB, anything
+  // larger is allocated on its exact size and never recycled.
+  static constexpr uint8_t MinimumClassShift = 12;
+  static constexpr uint8_t MaximumClassShift = 24;
+  static constexpr uint8_t ClassCount = MaximumClassShift - MinimumClassShift + 1;
+
+  // Idle blocks kept per size class, surplus goes back to the heap.
+  static constexpr uint8_t MaximumIdlePerClass = 4;
+
+  // Outstanding tokens tracked per pool, the limit is capped to this.
+  static constexpr uint8_t RingSize = 64;
+
+  // Buffers that are never returned (consumers that do not call
+  // ReleaseClearContent) are dropped, oldest first, beyond this depth when
+  // no limit is configured.
+  static constexpr uint8_t DefaultInFlight = 32;
+
+  // Longest a sample is held back for a token to come back. After that the
+  // consumer is assumed to not release tokens, see _releasing.
+  static constexpr uint32_t BackpressureTimeoutMs = 500;
+
+  // Buffer::slab of a block of its own.
+  static constexpr uint8_t NoSlab = 0xFF;
+
+public:
+  SecureBufferPool(const SecureBufferPool&) = delete;
+  SecureBufferPool& operator=(const SecureBufferPool&) = delete;
+
+  explicit SecureBufferPool(DecryptMetrics& metrics);
+  ~SecureBufferPool();
+
+public:
+  // Tokens a session may have outstanding before Acquire waits for one to
+  // be released, 0 turns the back-pressure off. Applies to later acquires.
+  static void InFlightLimit(uint8_t tokens);
+
+  // Reserves the slab for this session, false if it is disabled or the
+  // secure heap could not spare it.
+  bool Reserve();
+
+  // Holds the caller back while the consumer has the limit of tokens out,
+  // for at most BackpressureTimeoutMs. Called before the session takes its
+  // decrypt lock, Acquire itself does not wait.
+  void Wait();
+
+  // Returns a locked region of at least size bytes carrying a fresh token,
+  // nullptr if the secure heap is exhausted. With the slab reserved the
+  // region is carved out of a shared block where possible.
+  const Buffer* Acquire(uint32_t size);
+
+  // Makes the region behind the token available again, false if unknown.
+  bool Release(NEXUS_MemoryBlockTokenHandle token, uint32_t offset);
+
+  inline uint32_t Allocations() const {
+    return _allocations;
+  }
+  inline uint8_t InFlight() const {
+    return _inFlight;
+  }
+
+private:
+  static uint8_t SizeClass(uint32_t size);
+  void Admit();
+  void Abandon();
+  void Advance();
+  Buffer* Carve(uint32_t size);
+  Buffer* Allocate(uint32_t capacity);
+  void Recycle(Buffer* buffer);
+  void Destroy(Buffer* buffer);
+
+private:
+  static std::atomic<uint8_t> _limit;
+
+  DecryptMetrics& _metrics;
+  std::mutex _adminLock;
+  std::condition_variable _released;
+  NEXUS_HeapHandle _heap;
+  std::vector<Buffer*> _idle[ClassCount];
+  SecureSlab _slab;
+  // Records of slab regions, kept to not allocate them per sample.
+  std::vector<Buffer*> _spare;
+  // Slab regions dropped while their token was out, oldest first. The region
+  // goes back to the slab if the token is released after all.
+  std::vector<Buffer*> _abandoned;
+  // Tokens handed out from _head up to _tail, released ones are nullptr
+  // until the head moves past them.
+  Buffer* _ring[RingSize];
+  uint32_t _head;
+  uint32_t _tail;
+  std::atomic<uint8_t> _inFlight;
+  uint32_t _allocations;
+  // Cleared when a back-pressure wait timed out, set by every release. Only
+  // a consumer that returns tokens is waited for.
+  bool _releasing;
+};
+
+}  // namespace CDMi
@@ -0,0 +1,220 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SecureCopy.h"
+
+#include <nexus_platform.h>
+
+#include <chrono>
+#include <stdio.h>
+
+namespace CDMi {
+
+constexpr uint8_t SecureCopy::MaximumBlocks;
+constexpr uint32_t SecureCopy::CompletionTimeoutMs;
+
+/* static */ std::atomic<bool> SecureCopy::_enabled(true);
+/* static */ std::mutex SecureCopy::_engineLock;
+/* static */ NEXUS_DmaHandle SecureCopy::_engine = nullptr;
+/* static */ uint32_t SecureCopy::_jobs = 0;
+
+SecureCopy::SecureCopy(DecryptMetrics& metrics)
+  : _metrics(metrics)
+  , _job(nullptr)
+  , _blocks()
+  , _queued(0)
+  , _lock()
+  , _completed()
+  , _busy(false)
+  , _opened(false)
+  , _failed(false) {
+}
+
+SecureCopy::~SecureCopy() {
+  if (_job != nullptr) {
+    // A transfer still running would complete into a destroyed job.
+    Wait();
+    NEXUS_DmaJob_Destroy(_job);
+
+    std::lock_guard<std::mutex> guard(_engineLock);
+    if (--_jobs == 0) {
+      NEXUS_Dma_Close(_engine);
+      _engine = nullptr;
+    }
+  }
+}
+
+/* static */ void SecureCopy::Enable(bool enabled) {
+  _enabled = enabled;
+}
+
+bool SecureCopy::IsAvailable() {
+  if (_opened == false) {
+    _opened = true;
+    if ((_enabled == false) || (Open() == false)) {
+      _failed = true;
+    }
+  }
+  return (_failed == false);
+}
+
+bool SecureCopy::Open() {
+  std::lock_guard<std::mutex> guard(_engineLock);
+
+  if (_engine == nullptr) {
+    _engine = NEXUS_Dma_Open(0, nullptr);
+    if (_engine == nullptr) {
+      printf("No DMA engine, clear data is copied by the CDM\n");
+      return (false);
+    }
+  }
+
+  NEXUS_DmaJobSettings settings;
+  NEXUS_DmaJob_GetDefaultSettings(&settings);
+  settings.numBlocks = MaximumBlocks;
+  settings.completionCallback.callback = Completed;
+  settings.completionCallback.context = this;
+
+  _job = NEXUS_DmaJob_Create(_engine, &settings);
+  if (_job == nullptr) {
+    printf("Failed to create a DMA job, clear data is copied by the CDM\n");
+    if (_jobs == 0) {
+      NEXUS_Dma_Close(_engine);
+      _engine = nullptr;
+    }
+    return (false);
+  }
+
+  _jobs++;
+
+  for (NEXUS_DmaJobBlockSettings& block : _blocks) {
+    NEXUS_DmaJob_GetDefaultBlockSettings(&block);
+    // The engine does not keep crypto state between clear blocks. The
+    // secure destination has no CPU mapping to flush, the source is
+    // flushed in Add.
+    block.resetCrypto = true;
+    block.scatterGatherCryptoStart = true;
+    block.scatterGatherCryptoEnd = true;
+    block.cached = false;
+  }
+
+  return (true);
+}
+
+bool SecureCopy::Add(const uint8_t* source, uint8_t* destination, uint32_t length) {
+  if ((_queued == MaximumBlocks) && (Submit() == false)) {
+    return (false);
+  }
+
+  NEXUS_FlushCache(source, length);
+
+  NEXUS_DmaJobBlockSettings& block = _blocks[_queued++];
+  block.pSrcAddr = source;
+  block.pDestAddr = destination;
+  block.blockSize = length;
+  _metrics.SecureCopied(length);
+
+  return (true);
+}
+
+bool SecureCopy::Start() {
+  bool busy;
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    busy = _busy;
+  }
+  return (((_queued == 0) || (busy == true)) ? true : Submit());
+}
+
+bool SecureCopy::Finish() {
+  const uint64_t start = DecryptMetrics::Now();
+  const bool result = ((_failed == false) && ((_queued == 0) || (Submit() == true)) && (Wait() == true));
+
+  _metrics.Record(DecryptStatistics::STAGE_SECURE_COPY_WAIT, DecryptMetrics::Now() - start);
+
+  return (result);
+}
+
+// The job takes one batch at a time, a previous one has to be done first.
+bool SecureCopy::Submit() {
+  if (Wait() == false) {
+    return (false);
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    _busy = true;
+  }
+
+  // Not under _lock, the completion may be reported before this returns.
+  const NEXUS_Error rc = NEXUS_DmaJob_ProcessBlocks(_job, _blocks, _queued);
+  _queued = 0;
+
+  if (rc == NEXUS_DMA_QUEUED) {
+    return (true);
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    _busy = false;
+  }
+
+  if (rc != NEXUS_SUCCESS) {
+    printf("DMA transfer failed: %u\n", rc);
+    Fail();
+    return (false);
+  }
+  return (true);
+}
+
+bool SecureCopy::Wait() {
+  std::unique_lock<std::mutex> guard(_lock);
+
+  if (_completed.wait_for(guard, std::chrono::milliseconds(CompletionTimeoutMs), [this]() { return (_busy == false); }) == false) {
+    // Missed the callback? The job status tells.
+    NEXUS_DmaJobStatus status;
+    if ((NEXUS_DmaJob_GetStatus(_job, &status) != NEXUS_SUCCESS) || (status.currentState != NEXUS_DmaJobState_eComplete)) {
+      guard.unlock();
+      printf("DMA transfer timed out\n");
+      Fail();
+      return (false);
+    }
+    _busy = false;
+  }
+  return (true);
+}
+
+// Leaves the job to the destructor, the engine may still complete into it.
+void SecureCopy::Fail() {
+  if (_failed == false) {
+    _metrics.Failed(DecryptStatistics::FAILURE_SECURE_COPY);
+    _failed = true;
+  }
+  _queued = 0;
+}
+
+/* static */ void SecureCopy::Completed(void* context, int) {
+  SecureCopy* parent = static_cast<SecureCopy*>(context);
+
+  std::lock_guard<std::mutex> guard(parent->_lock);
+  parent->_busy = false;
+  parent->_completed.notify_all();
+}
+
+}  // namespace CDMi
@@ -0,0 +1,92 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "DecryptStatistics.h"
+
+#include <nexus_dma.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+
+namespace CDMi {
+
+// Moves the clear ranges of a video sample into secure memory with the Nexus
+// M2M DMA engine, so neither the CPU nor the CDM handle bytes that need no
+// decryption. Ranges are queued and handed to the engine in batches, which
+// run while the CDM decrypts the encrypted ranges; Finish waits for the
+// last one. Once a transfer failed the session copies through the CDM
+// again. Not thread safe, the session decrypt lock serializes the calls.
+class SecureCopy {
+private:
+  static constexpr uint8_t MaximumBlocks = 16;
+  static constexpr uint32_t CompletionTimeoutMs = 100;
+
+public:
+  SecureCopy(const SecureCopy&) = delete;
+  SecureCopy& operator=(const SecureCopy&) = delete;
+
+  explicit SecureCopy(DecryptMetrics& metrics);
+  ~SecureCopy();
+
+public:
+  // On by default, applies to sessions that did not open a job yet.
+  static void Enable(bool enabled);
+
+  // Opens the engine and the job of this session on first use.
+  bool IsAvailable();
+
+  // The source must be device accessible (Nexus) memory.
+  bool Add(const uint8_t* source, uint8_t* destination, uint32_t length);
+  // Hands the queued ranges to the engine unless it is still busy.
+  bool Start();
+  // Waits until every range added is in place.
+  bool Finish();
+
+private:
+  bool Open();
+  bool Submit();
+  bool Wait();
+  void Fail();
+
+  static void Completed(void* context, int param);
+
+private:
+  static std::atomic<bool> _enabled;
+  // The engine is shared by all sessions, open while any has a job.
+  static std::mutex _engineLock;
+  static NEXUS_DmaHandle _engine;
+  static uint32_t _jobs;
+
+  DecryptMetrics& _metrics;
+  NEXUS_DmaJobHandle _job;
+  NEXUS_DmaJobBlockSettings _blocks[MaximumBlocks];
+  uint8_t _queued;
+  // Guards _busy, which the completion callback clears from a Nexus thread.
+  std::mutex _lock;
+  std::condition_variable _completed;
+  bool _busy;
+  bool _opened;
+  bool _failed;
+};
+
+}  // namespace CDMi
@@ -0,0 +1,193 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "SecureSlab.h"
+
+#include <stdio.h>
+
+namespace CDMi {
+
+constexpr uint8_t SecureSlab::MinimumShift;
+constexpr uint8_t SecureSlab::MaximumShift;
+constexpr uint8_t SecureSlab::OrderCount;
+constexpr uint8_t SecureSlab::BlockCount;
+
+/* static */ std::atomic<uint32_t> SecureSlab::_reserve(0);
+
+SecureSlab::SecureSlab(DecryptMetrics& metrics)
+  : _metrics(metrics)
+  , _heap(NEXUS_Heap_Lookup(NEXUS_HeapLookupType_eCompressedRegion))
+  , _blocks()
+  , _blockCount(0)
+  , _topOrder(0) {
+}
+
+SecureSlab::~SecureSlab() {
+  // Regions still out are gone with their block.
+  for (uint8_t index = 0; index < _blockCount; index++) {
+    NEXUS_MemoryBlock_Unlock(_blocks[index].handle);
+    NEXUS_MemoryBlock_Free(_blocks[index].handle);
+  }
+}
+
+/* static */ void SecureSlab::Reserve(uint32_t bytes) {
+  _reserve = bytes;
+}
+
+bool SecureSlab::Allocate(uint32_t size, Region& region) {
+  uint8_t order = 0;
+
+  if (_blockCount == 0) {
+    return (false);
+  }
+
+  while ((order <= _topOrder) && ((static_cast<uint32_t>(1) << (MinimumShift + order)) < size)) {
+    order++;
+  }
+
+  if (order <= _topOrder) {
+    for (uint8_t index = 0; index < _blockCount; index++) {
+      uint32_t offset;
+      if (Split(_blocks[index], order, offset) == true) {
+        region.block = _blocks[index].handle;
+        region.opaque = _blocks[index].opaque;
+        region.offset = offset;
+        region.capacity = (static_cast<uint32_t>(1) << (MinimumShift + order));
+        region.index = index;
+        _metrics.SlabAllocated(region.capacity, size);
+        return (true);
+      }
+    }
+  }
+
+  return (false);
+}
+
+void SecureSlab::Free(const Region& region, uint32_t size) {
+  uint8_t order = 0;
+  while ((static_cast<uint32_t>(1) << (MinimumShift + order)) < region.capacity) {
+    order++;
+  }
+
+  Merge(_blocks[region.index], order, region.offset);
+  _metrics.SlabFreed(region.capacity, size);
+}
+
+// Reserves the blocks, the largest power of two that splits the reservation
+// over BlockCount of them.
+bool SecureSlab::Open() {
+  const uint32_t reserve = _reserve;
+  uint8_t shift = MinimumShift;
+
+  if ((_blockCount != 0) || (reserve == 0)) {
+    return (_blockCount != 0);
+  }
+
+  while ((shift < MaximumShift) && ((static_cast<uint64_t>(BlockCount) << (shift + 1)) <= reserve)) {
+    shift++;
+  }
+  if ((static_cast<uint64_t>(BlockCount) << shift) > reserve) {
+    printf("Secure slab reservation of %u bytes is too small\n", reserve);
+    return (false);
+  }
+
+  _topOrder = shift - MinimumShift;
+
+  for (uint8_t index = 0; index < BlockCount; index++) {
+    Block& block(_blocks[_blockCount]);
+
+    block.handle = NEXUS_MemoryBlock_Allocate(_heap, static_cast<size_t>(1) << shift, 0, nullptr);
+    if (block.handle == nullptr) {
+      printf("NexusBlockMemory could not reserve %u for the secure slab\n", 1u << shift);
+      break;
+    }
+    if (NEXUS_MemoryBlock_Lock(block.handle, &block.opaque) != 0) {
+      printf("NexusBlockMemory is not usable\n");
+      NEXUS_MemoryBlock_Free(block.handle);
+      break;
+    }
+
+    for (uint8_t order = 0; order <= _topOrder; order++) {
+      const uint32_t regions = (1u << (_topOrder - order));
+      block.free[order].assign((regions + 63) / 64, 0);
+    }
+    Set(block.free[_topOrder], 0);
+
+    _blockCount++;
+    _metrics.SlabReserved(static_cast<uint64_t>(1) << shift);
+    _metrics.SlabFragments(1);
+  }
+
+  return (_blockCount != 0);
+}
+
+// Takes the first free region of the order, splitting a larger one if needed.
+bool SecureSlab::Split(Block& block, uint8_t order, uint32_t& offset) {
+  uint8_t level = order;
+  uint32_t index = 0;
+  bool found = false;
+
+  while ((found == false) && (level <= _topOrder)) {
+    const std::vector<uint64_t>& bits(block.free[level]);
+    for (uint32_t word = 0; word < bits.size(); word++) {
+      if (bits[word] != 0) {
+        index = (word * 64) + static_cast<uint32_t>(__builtin_ctzll(bits[word]));
+        found = true;
+        break;
+      }
+    }
+    if (found == false) {
+      level++;
+    }
+  }
+
+  if (found == true) {
+    Clear(block.free[level], index);
+    _metrics.SlabFragments(-1);
+
+    // Keep the lower half, the upper half becomes a free buddy.
+    while (level > order) {
+      level--;
+      index *= 2;
+      Set(block.free[level], index + 1);
+      _metrics.SlabFragments(1);
+    }
+
+    offset = (index << (MinimumShift + order));
+  }
+
+  return (found);
+}
+
+void SecureSlab::Merge(Block& block, uint8_t order, uint32_t offset) {
+  uint32_t index = (offset >> (MinimumShift + order));
+
+  while ((order < _topOrder) && (Test(block.free[order], index ^ 1) == true)) {
+    Clear(block.free[order], index ^ 1);
+    _metrics.SlabFragments(-1);
+    index /= 2;
+    order++;
+  }
+
+  Set(block.free[order], index);
+  _metrics.SlabFragments(1);
+}
+
+}  // namespace CDMi
@@ -0,0 +1,122 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include "DecryptStatistics.h"
+
+#include <nexus_memory.h>
+
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+namespace CDMi {
+
+// What the consumer gets instead of a bare token while sub-allocation is
+// enabled: the output of a sample is the length bytes at offset in the block
+// behind the token. ReleaseClearContent takes the same descriptor back.
+struct SecureRegion {
+  NEXUS_MemoryBlockTokenHandle token;
+  uint32_t offset;
+  uint32_t length;
+};
+
+// Carves sample sized regions out of a few large secure blocks reserved when
+// the session starts, so hours of playback do not fragment the compressed region heap
+// with blocks of every size. Every block is a buddy system: regions are a
+// power of two from 4 KB up to the block size, and a freed region merges
+// with its free buddy right away. The bookkeeping is kept outside the secure
+// memory, which the CPU cannot read. Not thread safe, SecureBufferPool
+// serializes the calls.
+class SecureSlab {
+public:
+  struct Region {
+    NEXUS_MemoryBlockHandle block;
+    void* opaque;
+    uint32_t offset;
+    uint32_t capacity;
+    uint8_t index;
+  };
+
+private:
+  static constexpr uint8_t MinimumShift = 12;
+  static constexpr uint8_t MaximumShift = 28;
+  static constexpr uint8_t OrderCount = MaximumShift - MinimumShift + 1;
+  static constexpr uint8_t BlockCount = 2;
+
+  struct Block {
+    NEXUS_MemoryBlockHandle handle;
+    void* opaque;
+    // Bit i of order k: the region at i << (MinimumShift + k) is free.
+    std::vector<uint64_t> free[OrderCount];
+  };
+
+public:
+  SecureSlab(const SecureSlab&) = delete;
+  SecureSlab& operator=(const SecureSlab&) = delete;
+
+  explicit SecureSlab(DecryptMetrics& metrics);
+  ~SecureSlab();
+
+public:
+  // Secure memory a session reserves for sub-allocation, split over a few
+  // blocks, 0 disables it. Applies to sessions that did not reserve yet.
+  static void Reserve(uint32_t bytes);
+
+  static inline bool IsEnabled() {
+    return (_reserve != 0);
+  }
+
+  // Reserves the blocks, false if that failed or the slab is disabled.
+  bool Open();
+  inline bool IsOpen() const {
+    return (_blockCount != 0);
+  }
+
+  // False if no free region fits, the sample then needs a block of its own.
+  bool Allocate(uint32_t size, Region& region);
+  void Free(const Region& region, uint32_t size);
+
+private:
+  bool Split(Block& block, uint8_t order, uint32_t& offset);
+  void Merge(Block& block, uint8_t order, uint32_t offset);
+
+  static inline bool Test(const std::vector<uint64_t>& bits, uint32_t index) {
+    return ((bits[index / 64] & (static_cast<uint64_t>(1) << (index % 64))) != 0);
+  }
+  static inline void Set(std::vector<uint64_t>& bits, uint32_t index) {
+    bits[index / 64] |= (static_cast<uint64_t>(1) << (index % 64));
+  }
+  static inline void Clear(std::vector<uint64_t>& bits, uint32_t index) {
+    bits[index / 64] &= ~(static_cast<uint64_t>(1) << (index % 64));
+  }
+
+private:
+  static std::atomic<uint32_t> _reserve;
+
+  DecryptMetrics& _metrics;
+  NEXUS_HeapHandle _heap;
+  Block _blocks[BlockCount];
+  uint8_t _blockCount;
+  uint8_t _topOrder;
+};
+
+}  // namespace CDMi
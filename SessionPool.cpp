@@ -0,0 +1,121 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "SessionPool.h"
+#include "MediaSession.h"
+
+#include <chrono>
+
+namespace CDMi {
+
+constexpr uint32_t SessionPool::RetryDelayMs;
+
+SessionPool::SessionPool()
+  : _adminLock()
+  , _signal()
+  , _idle()
+  , _worker()
+  , _cdm(nullptr)
+  , _cdmLock(nullptr)
+  , _keys(nullptr)
+  , _size(0)
+  , _running(false)
+  , _hits(0)
+  , _misses(0) {
+}
+
+SessionPool::~SessionPool() {
+  Stop();
+}
+
+void SessionPool::Start(widevine::Cdm* cdm, CountingLock& cdmLock, KeyDirectory& keys, uint8_t size) {
+  if ((cdm != nullptr) && (size != 0) && (_worker.joinable() == false)) {
+    _cdm = cdm;
+    _cdmLock = &cdmLock;
+    _keys = &keys;
+    _size = size;
+    _idle.reserve(size);
+    _running = true;
+    _worker = std::thread(&SessionPool::Refill, this);
+  }
+}
+
+void SessionPool::Stop() {
+  if (_worker.joinable() == true) {
+    {
+      std::lock_guard<std::mutex> guard(_adminLock);
+      _running = false;
+    }
+    _signal.notify_one();
+    _worker.join();
+  }
+
+  for (MediaKeySession* session : _idle) {
+    session->Close();
+    delete session;
+  }
+  _idle.clear();
+}
+
+MediaKeySession* SessionPool::Take() {
+  MediaKeySession* session = nullptr;
+
+  if (_size != 0) {
+    std::lock_guard<std::mutex> guard(_adminLock);
+
+    if (_idle.empty() == false) {
+      session = _idle.back();
+      _idle.pop_back();
+      _hits++;
+    } else {
+      _misses++;
+    }
+    _signal.notify_one();
+  }
+
+  return (session);
+}
+
+void SessionPool::Refill() {
+  std::unique_lock<std::mutex> guard(_adminLock);
+
+  while (_running == true) {
+    if (_idle.size() >= _size) {
+      _signal.wait(guard);
+      continue;
+    }
+
+    // The CDM round-trip and the allocations happen without the pool lock,
+    // a take never waits for a session being prepared.
+    guard.unlock();
+    MediaKeySession* session = new MediaKeySession(_cdm, *_cdmLock, *_keys, Temporary);
+    guard.lock();
+
+    if (session->GetSessionId()[0] == '\0') {
+      TRACE_L1("Could not pre-create a session");
+      delete session;
+      _signal.wait_for(guard, std::chrono::milliseconds(RetryDelayMs));
+    } else {
+      _idle.push_back(session);
+    }
+  }
+}
+
+}  // namespace CDMi
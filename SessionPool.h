@@ -0,0 +1,84 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include "CountingLock.h"
+
+#include <cdm.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace CDMi {
+
+class KeyDirectory;
+class MediaKeySession;
+
+// Keeps a few temporary sessions created ahead of time, CDM session and
+// input memory included, so a channel change only has to Init one. A
+// background thread tops the pool up again after every take.
+class SessionPool {
+private:
+  // Back-off after the CDM refused to create a session.
+  static constexpr uint32_t RetryDelayMs = 1000;
+
+public:
+  SessionPool(const SessionPool&) = delete;
+  SessionPool& operator=(const SessionPool&) = delete;
+
+  SessionPool();
+  ~SessionPool();
+
+public:
+  void Start(widevine::Cdm* cdm, CountingLock& cdmLock, KeyDirectory& keys, uint8_t size);
+  void Stop();
+
+  // A fresh temporary session, nullptr if none is ready.
+  MediaKeySession* Take();
+
+  inline uint32_t Hits() const {
+    return (_hits);
+  }
+  inline uint32_t Misses() const {
+    return (_misses);
+  }
+
+private:
+  void Refill();
+
+private:
+  std::mutex _adminLock;
+  std::condition_variable _signal;
+  std::vector<MediaKeySession*> _idle;
+  std::thread _worker;
+  widevine::Cdm* _cdm;
+  CountingLock* _cdmLock;
+  KeyDirectory* _keys;
+  uint8_t _size;
+  bool _running;
+  std::atomic<uint32_t> _hits;
+  std::atomic<uint32_t> _misses;
+};
+
+}  // namespace CDMi
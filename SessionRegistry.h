@@ -0,0 +1,220 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include "MediaSession.h"
+#include "Rcu.h"
+
+#include <core/core.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace CDMi {
+
+// Session lookup for the CDM event listener. Sessions are spread over shards
+// by id so concurrent creation and teardown rarely meet. The table of a shard
+// is replaced copy-on-write behind an RcuPointer, so a lookup never takes a
+// lock. Sessions are reference counted and a dispatch keeps its session alive
+// until the callback returned.
+class SessionRegistry {
+public:
+  typedef std::shared_ptr<MediaKeySession> Session;
+
+private:
+  static constexpr uint8_t ShardCount = 16;
+
+  typedef std::unordered_map<std::string, Session> Table;
+
+  class Shard {
+  public:
+    Shard(const Shard&) = delete;
+    Shard& operator=(const Shard&) = delete;
+
+    Shard()
+      : _writerLock()
+      , _table(new Table()) {
+    }
+    ~Shard() {
+    }
+
+  public:
+    bool Insert(const std::string& sessionId, const Session& session) {
+      bool inserted = false;
+
+      _writerLock.Lock();
+
+      const Table& current(_table.Current());
+      if (current.find(sessionId) == current.end()) {
+        Table* table = new Table(current);
+        table->insert(Table::value_type(sessionId, session));
+        _table.Publish(table);
+        inserted = true;
+      }
+
+      _writerLock.Unlock();
+
+      return (inserted);
+    }
+
+    Session Remove(const std::string& sessionId) {
+      Session session;
+
+      _writerLock.Lock();
+
+      const Table& current(_table.Current());
+      Table::const_iterator index(current.find(sessionId));
+      if (index != current.end()) {
+        session = index->second;
+        Table* table = new Table(current);
+        table->erase(sessionId);
+        _table.Publish(table);
+      }
+
+      _writerLock.Unlock();
+
+      return (session);
+    }
+
+    void Clear() {
+      _writerLock.Lock();
+      _table.Publish(new Table());
+      _writerLock.Unlock();
+    }
+
+    Session Find(const std::string& sessionId) const {
+      Session session;
+      RcuPointer<Table>::ReadGuard table(_table);
+
+      Table::const_iterator index(table->find(sessionId));
+      if (index != table->end()) {
+        session = index->second;
+      }
+      return (session);
+    }
+
+    template <typename ACTION>
+    void ForEach(ACTION& action) const {
+      RcuPointer<Table>::ReadGuard table(_table);
+
+      for (const auto& entry : *table) {
+        action(*entry.second);
+      }
+    }
+
+  private:
+    WPEFramework::Core::CriticalSection _writerLock;
+    RcuPointer<Table> _table;
+  };
+
+public:
+  SessionRegistry(const SessionRegistry&) = delete;
+  SessionRegistry& operator=(const SessionRegistry&) = delete;
+
+  SessionRegistry() {
+  }
+  ~SessionRegistry() {
+  }
+
+public:
+  inline bool Insert(const std::string& sessionId, const Session& session) {
+    return (Select(sessionId).Insert(sessionId, session));
+  }
+
+  // Unlinks the session and waits until no other thread is dispatching to it.
+  // A dispatch on the calling thread (the client destroying the session from
+  // one of its callbacks) still holds a reference and frees it on return.
+  Session Remove(const std::string& sessionId) {
+    Session session(Select(sessionId).Remove(sessionId));
+
+    if (session) {
+      session->Detach();
+
+      const long references = (Dispatching() == session.get() ? 2 : 1);
+      while (session.use_count() > references) {
+        std::this_thread::yield();
+      }
+    }
+
+    return (session);
+  }
+
+  // Drops all sessions, only while no more events can arrive.
+  void Clear() {
+    for (Shard& shard : _shards) {
+      shard.Clear();
+    }
+  }
+
+  inline Session Find(const std::string& sessionId) const {
+    return (Select(sessionId).Find(sessionId));
+  }
+
+  // Runs action on the session outside of any lock, false if there is no such
+  // (attached) session.
+  template <typename ACTION>
+  bool Dispatch(const std::string& sessionId, ACTION action) const {
+    Session session(Find(sessionId));
+
+    if ((!session) || (session->IsDetached() == true)) {
+      return (false);
+    }
+
+    MediaKeySession*& dispatching(Dispatching());
+    MediaKeySession* outer = dispatching;
+    dispatching = session.get();
+    action(*session);
+    dispatching = outer;
+
+    return (true);
+  }
+
+  // Visits all sessions, writers of a shard wait until its walk is done so
+  // keep it short.
+  template <typename ACTION>
+  void ForEach(ACTION action) const {
+    for (const Shard& shard : _shards) {
+      shard.ForEach(action);
+    }
+  }
+
+private:
+  inline Shard& Select(const std::string& sessionId) {
+    return (_shards[std::hash<std::string>()(sessionId) % ShardCount]);
+  }
+  inline const Shard& Select(const std::string& sessionId) const {
+    return (_shards[std::hash<std::string>()(sessionId) % ShardCount]);
+  }
+
+  // Session being dispatched on the calling thread, if any.
+  static MediaKeySession*& Dispatching() {
+    static thread_local MediaKeySession* session = nullptr;
+    return (session);
+  }
+
+private:
+  Shard _shards[ShardCount];
+};
+
+}  // namespace CDMi
@@ -0,0 +1,87 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+namespace CDMi {
+
+// Bounded lock-free queue for exactly one producer and one consumer thread.
+template <typename ELEMENT, uint32_t CAPACITY>
+class SpscRing {
+private:
+  static_assert((CAPACITY != 0) && ((CAPACITY & (CAPACITY - 1)) == 0), "Capacity must be a power of two");
+
+public:
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  SpscRing()
+    : _head(0)
+    , _headPadding()
+    , _tail(0)
+    , _tailPadding() {
+  }
+  ~SpscRing() {
+  }
+
+public:
+  // Producer side.
+  inline bool Push(const ELEMENT& element) {
+    const uint32_t tail = _tail.load(std::memory_order_relaxed);
+
+    if ((tail - _head.load(std::memory_order_acquire)) == CAPACITY) {
+      return (false);
+    }
+
+    _slots[tail & (CAPACITY - 1)] = element;
+    _tail.store(tail + 1, std::memory_order_seq_cst);
+    return (true);
+  }
+
+  // Consumer side.
+  inline bool Pop(ELEMENT& element) {
+    const uint32_t head = _head.load(std::memory_order_relaxed);
+
+    if (head == _tail.load(std::memory_order_acquire)) {
+      return (false);
+    }
+
+    element = _slots[head & (CAPACITY - 1)];
+    _head.store(head + 1, std::memory_order_release);
+    return (true);
+  }
+
+  inline bool IsEmpty() const {
+    return (_head.load(std::memory_order_seq_cst) == _tail.load(std::memory_order_seq_cst));
+  }
+
+private:
+  // Padding keeps producer and consumer index on separate cache lines without
+  // requiring over-aligned allocation of the owner.
+  std::atomic<uint32_t> _head;
+  uint8_t _headPadding[64 - sizeof(std::atomic<uint32_t>)];
+  std::atomic<uint32_t> _tail;
+  uint8_t _tailPadding[64 - sizeof(std::atomic<uint32_t>)];
+  ELEMENT _slots[CAPACITY];
+};
+
+}  // namespace CDMi
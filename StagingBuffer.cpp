@@ -0,0 +1,145 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "StagingBuffer.h"
+
+#include <core/core.h>
+
+#include <nexus_memory.h>
+
+#include <string.h>
+
+namespace CDMi {
+
+constexpr uint32_t StagingBuffer::MinimumSize;
+constexpr uint32_t StagingBuffer::DefaultLimit;
+constexpr uint32_t StagingBuffer::WindowSamples;
+constexpr uint8_t StagingBuffer::ShrinkWindows;
+
+/* static */ std::atomic<uint32_t> StagingBuffer::_limit(StagingBuffer::DefaultLimit);
+
+StagingBuffer::StagingBuffer(DecryptMetrics& metrics)
+  : _metrics(metrics)
+  , _buffer(nullptr)
+  , _capacity(0)
+  , _highWater(0)
+  , _quietHighWater(0)
+  , _samples(0)
+  , _quietWindows(0) {
+
+  Resize(MinimumSize);
+}
+
+StagingBuffer::~StagingBuffer() {
+  if (_buffer != nullptr) {
+    NEXUS_Memory_Free(_buffer);
+    _metrics.InputResized(_capacity, 0);
+  }
+}
+
+/* static */ void StagingBuffer::Limit(uint32_t bytes) {
+  _limit = (bytes < MinimumSize ? MinimumSize : bytes);
+}
+
+const uint8_t* StagingBuffer::Stage(const uint8_t* data, uint32_t length) {
+  if (length > _capacity) {
+    const uint32_t limit = _limit;
+    uint64_t capacity = (_capacity != 0 ? _capacity : MinimumSize);
+
+    while (capacity < length) {
+      capacity *= 2;
+    }
+    if (capacity > limit) {
+      capacity = limit;
+    }
+
+    if (length > capacity) {
+      _metrics.Failed(DecryptStatistics::FAILURE_INPUT_MEMORY);
+      TRACE_L1("Sample of %u bytes exceeds the input limit of %u", length, limit);
+      return (nullptr);
+    }
+    if (Resize(static_cast<uint32_t>(capacity)) == false) {
+      TRACE_L1("Could not stage %u bytes of input, holding %u", length, _capacity);
+      return (nullptr);
+    }
+  }
+
+  ::memcpy(_buffer, data, length);
+
+  Observe(length);
+
+  return (reinterpret_cast<const uint8_t*>(_buffer));
+}
+
+void StagingBuffer::Observe(uint32_t length) {
+  if (length > _highWater) {
+    _highWater = length;
+  }
+
+  if (++_samples == WindowSamples) {
+    if ((static_cast<uint64_t>(_highWater) * 4) <= _capacity) {
+      _quietWindows++;
+      if (_highWater > _quietHighWater) {
+        _quietHighWater = _highWater;
+      }
+    } else {
+      _quietWindows = 0;
+      _quietHighWater = 0;
+    }
+
+    if (_quietWindows == ShrinkWindows) {
+      // Keep twice the peak of all quiet windows, not just the last one,
+      // so a single larger sample still fits.
+      uint64_t capacity = MinimumSize;
+      while (capacity < (static_cast<uint64_t>(_quietHighWater) * 2)) {
+        capacity *= 2;
+      }
+      if (capacity < _capacity) {
+        Resize(static_cast<uint32_t>(capacity));
+      }
+      _quietWindows = 0;
+      _quietHighWater = 0;
+    }
+
+    _highWater = 0;
+    _samples = 0;
+  }
+}
+
+bool StagingBuffer::Resize(uint32_t capacity) {
+  void* buffer = nullptr;
+
+  if ((NEXUS_Memory_Allocate(capacity, nullptr, &buffer) != 0) || (buffer == nullptr)) {
+    _metrics.Failed(DecryptStatistics::FAILURE_INPUT_MEMORY);
+    return (false);
+  }
+
+  if (_buffer != nullptr) {
+    NEXUS_Memory_Free(_buffer);
+  }
+
+  _metrics.InputResized(_capacity, capacity);
+  _buffer = buffer;
+  _capacity = capacity;
+
+  return (true);
+}
+
+}  // namespace CDMi
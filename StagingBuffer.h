@@ -0,0 +1,80 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include "DecryptStatistics.h"
+
+#include <atomic>
+#include <stdint.h>
+
+namespace CDMi {
+
+// Device accessible copy of heap input, sized by what the session actually
+// decrypts: it starts small, doubles when a sample does not fit and halves
+// back once demand stayed well below the capacity for a while. A resize
+// allocates the new buffer before the old one is released, so a failed
+// allocation leaves the current buffer in place.
+class StagingBuffer {
+private:
+  static constexpr uint32_t MinimumSize = 16 * 1024;
+  static constexpr uint32_t DefaultLimit = 16 * 1024 * 1024;
+
+  // Demand is judged per window of samples; the buffer shrinks after this
+  // many windows in a row used no more than a quarter of it.
+  static constexpr uint32_t WindowSamples = 256;
+  static constexpr uint8_t ShrinkWindows = 4;
+
+public:
+  StagingBuffer(const StagingBuffer&) = delete;
+  StagingBuffer& operator=(const StagingBuffer&) = delete;
+
+  explicit StagingBuffer(DecryptMetrics& metrics);
+  ~StagingBuffer();
+
+public:
+  // Largest buffer any session may hold, applies to later resizes.
+  static void Limit(uint32_t bytes);
+
+  // Copies the sample in, nullptr if it does not fit the limit or memory ran out.
+  const uint8_t* Stage(const uint8_t* data, uint32_t length);
+
+  inline uint32_t Capacity() const {
+    return (_capacity);
+  }
+
+private:
+  bool Resize(uint32_t capacity);
+  void Observe(uint32_t length);
+
+private:
+  static std::atomic<uint32_t> _limit;
+
+  DecryptMetrics& _metrics;
+  void* _buffer;
+  uint32_t _capacity;
+  uint32_t _highWater;
+  // Largest sample of the quiet windows so far.
+  uint32_t _quietHighWater;
+  uint32_t _samples;
+  uint8_t _quietWindows;
+};
+
+}  // namespace CDMi
@@ -0,0 +1,74 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace CDMi {
+
+// How long the plugin took to come up, all times in nanoseconds. Only
+// registering the plugin is on the boot path, the CDM is set up by a
+// background thread.
+struct StartupStatistics {
+  enum Phase : uint8_t {
+    PHASE_REGISTER,    // Initialize, until the plugin could register
+    PHASE_JOIN,        // NxClient_Join
+    PHASE_STORAGE,     // opening the storage directory or container
+    PHASE_CERTIFICATE, // reading the device certificate
+    PHASE_INITIALIZE,  // widevine::Cdm::initialize
+    PHASE_CREATE,      // widevine::Cdm::create, all instances
+    PHASE_COUNT
+  };
+
+  static const char* PhaseName(Phase phase) {
+    switch (phase) {
+    case PHASE_REGISTER:
+      return "register";
+    case PHASE_JOIN:
+      return "join";
+    case PHASE_STORAGE:
+      return "storage";
+    case PHASE_CERTIFICATE:
+      return "certificate";
+    case PHASE_INITIALIZE:
+      return "initialize";
+    case PHASE_CREATE:
+      return "create";
+    default:
+      return "unknown";
+    }
+  }
+
+  bool ready;
+  uint64_t phases[PHASE_COUNT]; // 0 until the phase ran
+  uint64_t total;  // from Initialize until the CDM was ready
+  uint32_t waits;  // sessions created before that, which had to wait
+  uint64_t waited; // the longest of those waits
+};
+
+// Implemented by the WideVine system, reachable through a dynamic_cast of
+// the IMediaKeys instance.
+struct IStartupStatistics {
+  virtual ~IStartupStatistics() {}
+
+  virtual void Statistics(StartupStatistics& statistics) const = 0;
+};
+
+}  // namespace CDMi
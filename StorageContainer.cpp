@@ -0,0 +1,581 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "StorageContainer.h"
+
+#include <core/core.h>
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace CDMi {
+
+constexpr uint32_t StorageContainer::WriteBehindDelayMs;
+constexpr uint32_t StorageContainer::MaximumRetryDelayMs;
+constexpr uint32_t StorageContainer::CloseAttempts;
+constexpr uint32_t StorageContainer::CompactionThreshold;
+
+static constexpr uint32_t FileMagic = 0x54535657; // "WVST"
+static constexpr uint32_t FileVersion = 1;
+static constexpr uint32_t RecordMagic = 0x43525657; // "WVRC"
+static constexpr uint32_t RecordPut = 1;
+static constexpr uint32_t RecordRemove = 2;
+
+struct FileHeader {
+  uint32_t magic;
+  uint32_t version;
+};
+
+struct RecordHeader {
+  uint32_t magic;
+  uint32_t type;
+  uint32_t nameLength;
+  uint32_t dataLength;
+  uint32_t checksum;
+};
+
+static uint32_t Checksum(const uint8_t* name, uint32_t nameLength, const uint8_t* data, uint32_t dataLength) {
+  // FNV-1a, only there to detect a torn tail after a power cut.
+  uint32_t hash = 2166136261u;
+  for (uint32_t index = 0; index < nameLength; index++) {
+    hash = (hash ^ name[index]) * 16777619u;
+  }
+  for (uint32_t index = 0; index < dataLength; index++) {
+    hash = (hash ^ data[index]) * 16777619u;
+  }
+  return (hash);
+}
+
+static void AppendRecord(std::string& buffer, uint32_t type, const std::string& name, const uint8_t* data, uint32_t dataLength) {
+  RecordHeader header;
+  header.magic = RecordMagic;
+  header.type = type;
+  header.nameLength = static_cast<uint32_t>(name.size());
+  header.dataLength = dataLength;
+  header.checksum = Checksum(reinterpret_cast<const uint8_t*>(name.data()), header.nameLength, data, dataLength);
+
+  buffer.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  buffer.append(name);
+  buffer.append(reinterpret_cast<const char*>(data), dataLength);
+}
+
+static bool WriteAt(int fd, const std::string& buffer, off_t offset) {
+  const char* data = buffer.data();
+  size_t remaining = buffer.size();
+  while (remaining > 0) {
+    ssize_t written = ::pwrite(fd, data, remaining, offset);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return (false);
+    }
+    data += written;
+    offset += written;
+    remaining -= written;
+  }
+  return (true);
+}
+
+static bool ReadAt(int fd, uint8_t* buffer, size_t length, off_t offset) {
+  while (length > 0) {
+    ssize_t count = ::pread(fd, buffer, length, offset);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return (false);
+    }
+    if (count == 0) {
+      return (false);
+    }
+    buffer += count;
+    offset += count;
+    length -= count;
+  }
+  return (true);
+}
+
+// Makes a rename in the directory of path durable.
+static void SyncDirectory(const std::string& path) {
+  const std::string::size_type slash = path.rfind('/');
+  const std::string directory(slash == std::string::npos ? std::string(".") : path.substr(0, slash + 1));
+  int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd >= 0) {
+    ::fsync(fd);
+    ::close(fd);
+  }
+}
+
+StorageContainer::StorageContainer()
+  : _adminLock()
+  , _signal()
+  , _path()
+  , _fd(-1)
+  , _mapping(nullptr)
+  , _mappedSize(0)
+  , _fileSize(0)
+  , _garbage(0)
+  , _index()
+  , _pending()
+  , _committing()
+  , _writer()
+  , _running(false) {
+}
+
+StorageContainer::~StorageContainer() {
+  Close();
+}
+
+bool StorageContainer::Open(const std::string& path) {
+  ASSERT(_fd < 0);
+
+  _fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0600);
+  if (_fd < 0) {
+    TRACE_L1("Could not open storage container %s: %d", path.c_str(), errno);
+    return (false);
+  }
+
+  _path = path;
+
+  struct stat info;
+  FileHeader header;
+  bool valid = (::fstat(_fd, &info) == 0) && (info.st_size >= static_cast<off_t>(sizeof(header))) &&
+               (::pread(_fd, &header, sizeof(header), 0) == sizeof(header)) &&
+               (header.magic == FileMagic) && (header.version == FileVersion);
+
+  if (valid == false) {
+    // New or unusable, start from an empty container.
+    header.magic = FileMagic;
+    header.version = FileVersion;
+    if ((::ftruncate(_fd, 0) != 0) ||
+        (WriteAt(_fd, std::string(reinterpret_cast<const char*>(&header), sizeof(header)), 0) == false)) {
+      TRACE_L1("Could not initialize storage container %s: %d", path.c_str(), errno);
+      ::close(_fd);
+      _fd = -1;
+      return (false);
+    }
+    info.st_size = sizeof(header);
+  }
+
+  _fileSize = static_cast<uint32_t>(info.st_size);
+
+  if ((Map(_fileSize) == false) || (Scan() == false)) {
+    Unmap();
+    ::close(_fd);
+    _fd = -1;
+    return (false);
+  }
+
+  _running = true;
+  _writer = std::thread(&StorageContainer::WriteBehind, this);
+
+  return (true);
+}
+
+void StorageContainer::Close() {
+  if (_writer.joinable() == true) {
+    {
+      std::lock_guard<std::mutex> guard(_adminLock);
+      _running = false;
+    }
+    _signal.notify_one();
+    _writer.join();
+  }
+
+  Unmap();
+
+  if (_fd >= 0) {
+    ::close(_fd);
+    _fd = -1;
+  }
+
+  _index.clear();
+}
+
+// Only drops the current mapping once the new one is in place, a failure
+// leaves the previous one usable.
+bool StorageContainer::Map(uint32_t size) {
+  void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, _fd, 0);
+  if (mapping == MAP_FAILED) {
+    TRACE_L1("Could not map storage container %s: %d", _path.c_str(), errno);
+    return (false);
+  }
+
+  Unmap();
+
+  _mapping = static_cast<const uint8_t*>(mapping);
+  _mappedSize = size;
+  return (true);
+}
+
+void StorageContainer::Unmap() {
+  if (_mapping != nullptr) {
+    ::munmap(const_cast<uint8_t*>(_mapping), _mappedSize);
+    _mapping = nullptr;
+    _mappedSize = 0;
+  }
+}
+
+// Records appended after the last successful Map are read from the file.
+bool StorageContainer::Fetch(const Entry& entry, std::string* data) const {
+  if ((entry.offset + entry.length) <= _mappedSize) {
+    data->assign(reinterpret_cast<const char*>(&_mapping[entry.offset]), entry.length);
+    return (true);
+  }
+
+  data->resize(entry.length);
+  return ((entry.length == 0) || (ReadAt(_fd, reinterpret_cast<uint8_t*>(&(*data)[0]), entry.length, entry.offset) == true));
+}
+
+// Rebuilds the index from the records, dropping a torn tail if there is one.
+bool StorageContainer::Scan() {
+  uint32_t offset = sizeof(FileHeader);
+
+  _index.clear();
+  _garbage = 0;
+
+  while ((_fileSize - offset) >= sizeof(RecordHeader)) {
+    RecordHeader header;
+    ::memcpy(&header, &_mapping[offset], sizeof(header));
+
+    const uint32_t payload = _fileSize - offset - sizeof(header);
+    if ((header.magic != RecordMagic) || (header.nameLength > payload) || (header.dataLength > (payload - header.nameLength))) {
+      break;
+    }
+
+    const uint8_t* name = &_mapping[offset + sizeof(header)];
+    const uint8_t* data = name + header.nameLength;
+    if (Checksum(name, header.nameLength, data, header.dataLength) != header.checksum) {
+      break;
+    }
+
+    const uint32_t recordSize = sizeof(header) + header.nameLength + header.dataLength;
+    std::string key(reinterpret_cast<const char*>(name), header.nameLength);
+    Index::iterator index(_index.find(key));
+
+    if (index != _index.end()) {
+      _garbage += sizeof(RecordHeader) + header.nameLength + index->second.length;
+    }
+
+    if (header.type == RecordPut) {
+      Entry& entry(_index[key]);
+      entry.offset = offset + sizeof(header) + header.nameLength;
+      entry.length = header.dataLength;
+    } else {
+      if (index != _index.end()) {
+        _index.erase(index);
+      }
+      _garbage += recordSize;
+    }
+
+    offset += recordSize;
+  }
+
+  if (offset != _fileSize) {
+    TRACE_L1("Storage container %s truncated from %u to %u bytes", _path.c_str(), _fileSize, offset);
+    if (::ftruncate(_fd, offset) != 0) {
+      return (false);
+    }
+    _fileSize = offset;
+    return (Map(_fileSize));
+  }
+
+  return (true);
+}
+
+const StorageContainer::Pending* StorageContainer::FindPending(const std::string& name) const {
+  PendingMap::const_iterator index(_pending.find(name));
+  if (index != _pending.end()) {
+    return (&(index->second));
+  }
+  index = _committing.find(name);
+  if (index != _committing.end()) {
+    return (&(index->second));
+  }
+  return (nullptr);
+}
+
+bool StorageContainer::Read(const std::string& name, std::string* data) const {
+  bool result = false;
+  std::lock_guard<std::mutex> guard(_adminLock);
+
+  const Pending* pending = FindPending(name);
+  if (pending != nullptr) {
+    if (pending->remove == false) {
+      *data = pending->data;
+      result = true;
+    }
+  } else {
+    Index::const_iterator index(_index.find(name));
+    if (index != _index.end()) {
+      result = Fetch(index->second, data);
+    }
+  }
+
+  return (result);
+}
+
+bool StorageContainer::Exists(const std::string& name) const {
+  std::lock_guard<std::mutex> guard(_adminLock);
+
+  const Pending* pending = FindPending(name);
+  return (pending != nullptr ? (pending->remove == false) : (_index.find(name) != _index.end()));
+}
+
+int32_t StorageContainer::Size(const std::string& name) const {
+  int32_t result = -1;
+  std::lock_guard<std::mutex> guard(_adminLock);
+
+  const Pending* pending = FindPending(name);
+  if (pending != nullptr) {
+    if (pending->remove == false) {
+      result = static_cast<int32_t>(pending->data.size());
+    }
+  } else {
+    Index::const_iterator index(_index.find(name));
+    if (index != _index.end()) {
+      result = static_cast<int32_t>(index->second.length);
+    }
+  }
+
+  return (result);
+}
+
+void StorageContainer::List(std::vector<std::string>* names) const {
+  std::lock_guard<std::mutex> guard(_adminLock);
+
+  for (const auto& entry : _index) {
+    if (FindPending(entry.first) == nullptr) {
+      names->push_back(entry.first);
+    }
+  }
+  for (const PendingMap* pending : { &_committing, &_pending }) {
+    for (const auto& entry : *pending) {
+      if ((entry.second.remove == false) && ((pending == &_pending) || (_pending.find(entry.first) == _pending.end()))) {
+        names->push_back(entry.first);
+      }
+    }
+  }
+}
+
+// The writer is only woken for the first change of a batch, it collects
+// whatever follows until its delay runs out.
+void StorageContainer::Write(const std::string& name, const std::string& data) {
+  std::lock_guard<std::mutex> guard(_adminLock);
+  Pending& entry(_pending[name]);
+  entry.remove = false;
+  entry.data = data;
+  if (_pending.size() == 1) {
+    _signal.notify_one();
+  }
+}
+
+void StorageContainer::Remove(const std::string& name) {
+  std::lock_guard<std::mutex> guard(_adminLock);
+  Pending& entry(_pending[name]);
+  entry.remove = true;
+  entry.data.clear();
+  if (_pending.size() == 1) {
+    _signal.notify_one();
+  }
+}
+
+void StorageContainer::RemoveAll() {
+  std::lock_guard<std::mutex> guard(_adminLock);
+  const bool idle = _pending.empty();
+  for (const auto& entry : _index) {
+    _pending[entry.first].remove = true;
+  }
+  for (const auto& entry : _committing) {
+    _pending[entry.first].remove = true;
+  }
+  for (auto& entry : _pending) {
+    entry.second.remove = true;
+    entry.second.data.clear();
+  }
+  if ((idle == true) && (_pending.empty() == false)) {
+    _signal.notify_one();
+  }
+}
+
+void StorageContainer::WriteBehind() {
+  std::unique_lock<std::mutex> guard(_adminLock);
+  uint32_t failures = 0;
+
+  while ((_running == true) || (_pending.empty() == false)) {
+    if (_pending.empty() == true) {
+      _signal.wait(guard);
+      continue;
+    }
+
+    if (_running == true) {
+      // Back off while the file keeps failing, Close cuts the wait short.
+      const uint32_t delay = (failures == 0 ? WriteBehindDelayMs :
+          std::min<uint32_t>(WriteBehindDelayMs << std::min<uint32_t>(failures, 16), MaximumRetryDelayMs));
+      const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(delay);
+      _signal.wait_until(guard, deadline, [this]() { return (_running == false); });
+    }
+
+    // Lookups keep seeing the batch through _committing until it is indexed.
+    _committing.swap(_pending);
+
+    guard.unlock();
+    bool appended = Append(_committing);
+    guard.lock();
+
+    if (appended == true) {
+      failures = 0;
+    } else if ((++failures >= CloseAttempts) && (_running == false)) {
+      // Closing, do not hold up the teardown on a file that cannot be written.
+      std::string dropped;
+      for (const PendingMap* batch : { &_committing, &_pending }) {
+        for (const auto& entry : *batch) {
+          dropped += ' ';
+          dropped += entry.first;
+        }
+      }
+      TRACE_L1("Dropped changes of storage container %s:%s", _path.c_str(), dropped.c_str());
+      _pending.clear();
+    } else {
+      // Keep the changes around for the next round, newer ones take precedence.
+      for (auto& entry : _committing) {
+        _pending.insert(std::move(entry));
+      }
+    }
+    _committing.clear();
+
+    if ((_garbage > CompactionThreshold) && (_garbage > (_fileSize - _garbage))) {
+      guard.unlock();
+      Compact();
+      guard.lock();
+    }
+  }
+}
+
+// Runs on the writer thread only, which is the only one changing the file.
+bool StorageContainer::Append(const PendingMap& batch) {
+  std::string buffer;
+
+  for (const auto& entry : batch) {
+    if (entry.second.remove == true) {
+      AppendRecord(buffer, RecordRemove, entry.first, nullptr, 0);
+    } else {
+      AppendRecord(buffer, RecordPut, entry.first,
+          reinterpret_cast<const uint8_t*>(entry.second.data.data()), static_cast<uint32_t>(entry.second.data.size()));
+    }
+  }
+
+  if ((WriteAt(_fd, buffer, _fileSize) == false) || (::fdatasync(_fd) != 0)) {
+    TRACE_L1("Could not append to storage container %s: %d", _path.c_str(), errno);
+    return (false);
+  }
+
+  std::lock_guard<std::mutex> guard(_adminLock);
+
+  // The records are on disk, so they get indexed either way. Without the
+  // larger mapping they are read from the file until a later Map succeeds.
+  Map(_fileSize + static_cast<uint32_t>(buffer.size()));
+
+  uint32_t offset = _fileSize;
+  for (const auto& entry : batch) {
+    const uint32_t nameLength = static_cast<uint32_t>(entry.first.size());
+    const uint32_t dataLength = static_cast<uint32_t>(entry.second.data.size());
+    Index::iterator index(_index.find(entry.first));
+
+    if (index != _index.end()) {
+      _garbage += sizeof(RecordHeader) + nameLength + index->second.length;
+    }
+
+    if (entry.second.remove == true) {
+      if (index != _index.end()) {
+        _index.erase(index);
+      }
+      _garbage += sizeof(RecordHeader) + nameLength;
+      offset += sizeof(RecordHeader) + nameLength;
+    } else {
+      Entry& target(_index[entry.first]);
+      target.offset = offset + sizeof(RecordHeader) + nameLength;
+      target.length = dataLength;
+      offset += sizeof(RecordHeader) + nameLength + dataLength;
+    }
+  }
+  _fileSize = offset;
+
+  return (true);
+}
+
+// Writes the live records to a fresh file and swaps it in.
+bool StorageContainer::Compact() {
+  const std::string temporary(_path + ".tmp");
+  FileHeader header;
+  header.magic = FileMagic;
+  header.version = FileVersion;
+
+  std::string buffer(reinterpret_cast<const char*>(&header), sizeof(header));
+  std::string data;
+  Index index;
+
+  for (const auto& entry : _index) {
+    if (Fetch(entry.second, &data) == false) {
+      TRACE_L1("Could not read %s for compaction: %d", entry.first.c_str(), errno);
+      return (false);
+    }
+    Entry& target(index[entry.first]);
+    target.offset = static_cast<uint32_t>(buffer.size() + sizeof(RecordHeader) + entry.first.size());
+    target.length = entry.second.length;
+    AppendRecord(buffer, RecordPut, entry.first, reinterpret_cast<const uint8_t*>(data.data()), entry.second.length);
+  }
+
+  int fd = ::open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0) {
+    return (false);
+  }
+
+  if ((WriteAt(fd, buffer, 0) == false) || (::fsync(fd) != 0) || (::rename(temporary.c_str(), _path.c_str()) != 0)) {
+    TRACE_L1("Could not compact storage container %s: %d", _path.c_str(), errno);
+    ::close(fd);
+    ::unlink(temporary.c_str());
+    return (false);
+  }
+
+  SyncDirectory(_path);
+
+  std::lock_guard<std::mutex> guard(_adminLock);
+
+  ::close(_fd);
+  _fd = fd;
+  _fileSize = static_cast<uint32_t>(buffer.size());
+  _garbage = 0;
+  _index.swap(index);
+
+  // The old mapping belongs to the replaced file, never serve from it.
+  if (Map(_fileSize) == false) {
+    Unmap();
+    return (false);
+  }
+  return (true);
+}
+
+}  // namespace CDMi
@@ -0,0 +1,112 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace CDMi {
+
+// All CDM files in a single append-only file: a small header followed by
+// put/remove records. The file is memory mapped and indexed at open, so
+// lookups never touch the file system. Changes are appended by a background
+// writer, which also rewrites the file once most of it is stale.
+class StorageContainer {
+private:
+  struct Entry {
+    uint32_t offset;
+    uint32_t length;
+  };
+
+  struct Pending {
+    bool remove;
+    std::string data;
+  };
+
+  typedef std::unordered_map<std::string, Entry> Index;
+  typedef std::map<std::string, Pending> PendingMap;
+
+  static constexpr uint32_t WriteBehindDelayMs = 100;
+
+  // A failed append is retried with a doubling delay up to this maximum.
+  static constexpr uint32_t MaximumRetryDelayMs = 10 * 1000;
+
+  // Appends tried on Close before the remaining changes are dropped.
+  static constexpr uint32_t CloseAttempts = 3;
+
+  // Compact once stale records outweigh live ones and exceed this size.
+  static constexpr uint32_t CompactionThreshold = 64 * 1024;
+
+public:
+  StorageContainer(const StorageContainer&) = delete;
+  StorageContainer& operator=(const StorageContainer&) = delete;
+
+  StorageContainer();
+  ~StorageContainer();
+
+public:
+  bool Open(const std::string& path);
+  void Close();
+
+  inline bool IsOpen() const {
+    return (_fd >= 0);
+  }
+
+  bool Read(const std::string& name, std::string* data) const;
+  bool Exists(const std::string& name) const;
+  int32_t Size(const std::string& name) const;
+  void List(std::vector<std::string>* names) const;
+
+  void Write(const std::string& name, const std::string& data);
+  void Remove(const std::string& name);
+  void RemoveAll();
+
+private:
+  const Pending* FindPending(const std::string& name) const;
+  bool Map(uint32_t size);
+  void Unmap();
+  bool Fetch(const Entry& entry, std::string* data) const;
+  bool Scan();
+  void WriteBehind();
+  bool Append(const PendingMap& batch);
+  bool Compact();
+
+private:
+  mutable std::mutex _adminLock;
+  std::condition_variable _signal;
+  std::string _path;
+  int _fd;
+  const uint8_t* _mapping;
+  uint32_t _mappedSize;
+  uint32_t _fileSize;
+  uint32_t _garbage;
+  Index _index;
+  PendingMap _pending;
+  PendingMap _committing;
+  std::thread _writer;
+  bool _running;
+};
+
+}  // namespace CDMi
@@ -0,0 +1,670 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Offline benchmark of the decrypt path: the plugin sources linked against a
+// stand-in CDM (OpenSSL) and a heap backed Nexus shim.
+//
+//   widevine-benchmark [iterations] [mode]
+//
+// With a mode only that one is measured, e.g. "async" in a build with
+// -fsanitize=thread.
+
+#include "AsyncDecrypt.h"
+#include "BatchDecrypt.h"
+#include "DecryptStatistics.h"
+#include "MediaSession.h"
+#include "SecureSlab.h"
+#include "StartupStatistics.h"
+
+#include "Session.h"
+#include "fake/FakeCdm.h"
+#include "fake/NexusShim.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+static std::atomic<uint64_t> g_heapAllocations(0);
+
+// Only measure this mode, all of them if not set.
+static const char* g_mode = nullptr;
+
+void* operator new(size_t size) {
+  g_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+  void* result = ::malloc(size == 0 ? 1 : size);
+  if (result == nullptr) {
+    throw std::bad_alloc();
+  }
+  return (result);
+}
+
+void* operator new[](size_t size) {
+  return (operator new(size));
+}
+
+void operator delete(void* memory) noexcept {
+  ::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+  ::free(memory);
+}
+
+namespace {
+
+struct Sample {
+  std::vector<uint8_t> clear;
+  std::vector<uint8_t> encrypted;
+  std::vector<uint32_t> subSamples;
+  uint8_t iv[8];
+};
+
+// Encrypts like a CENC packager: all encrypted ranges form one CTR stream.
+// With subsamples every slice gets a small clear header and an encrypted body
+// that is deliberately not block aligned.
+void Prepare(Sample& sample, uint32_t size, bool subSamples, const uint8_t keyId[16], std::mt19937& random) {
+  sample.clear.resize(size);
+  for (uint8_t& byte : sample.clear) {
+    byte = static_cast<uint8_t>(random());
+  }
+  for (uint8_t& byte : sample.iv) {
+    byte = static_cast<uint8_t>(random());
+  }
+
+  sample.subSamples.clear();
+  if (subSamples == true) {
+    uint32_t remaining = size;
+    while (remaining > 0) {
+      const uint32_t clear = std::min<uint32_t>(remaining, 5 + (random() % 64));
+      const uint32_t encrypted = std::min<uint32_t>(remaining - clear, (size / 4) + 3);
+      sample.subSamples.push_back(clear);
+      sample.subSamples.push_back(encrypted);
+      remaining -= clear + encrypted;
+    }
+  }
+
+  uint8_t key[16];
+  uint8_t iv[16] = {};
+  ::memcpy(iv, sample.iv, sizeof(sample.iv));
+  Shim::ContentKey(keyId, 16, key);
+
+  std::vector<uint8_t> stream;
+  std::vector<uint32_t> ranges(sample.subSamples);
+  if (ranges.empty() == true) {
+    ranges.push_back(0);
+    ranges.push_back(size);
+  }
+  for (uint32_t index = 0, offset = 0; index < ranges.size(); index += 2) {
+    offset += ranges[index];
+    stream.insert(stream.end(), &sample.clear[offset], &sample.clear[offset] + ranges[index + 1]);
+    offset += ranges[index + 1];
+  }
+  std::vector<uint8_t> cipher(stream.size());
+  Shim::Cipher(true, widevine::Cdm::kAesCtr, widevine::Cdm::Pattern(), key, iv, 0, stream.data(), cipher.data(), cipher.size());
+
+  sample.encrypted = sample.clear;
+  for (uint32_t index = 0, offset = 0, position = 0; index < ranges.size(); index += 2) {
+    offset += ranges[index];
+    ::memcpy(&sample.encrypted[offset], &cipher[position], ranges[index + 1]);
+    offset += ranges[index + 1];
+    position += ranges[index + 1];
+  }
+}
+
+// Secure memory reserved per session in slab mode.
+const uint32_t SlabReserve = 8 * 1024 * 1024;
+
+// Distinct samples per session, also the size of a batch.
+const uint32_t SamplesPerSession = 8;
+
+enum Mode {
+  MODE_HEAP,  // video, input on the heap
+  MODE_NEXUS, // video, input in Nexus memory
+  MODE_AUDIO, // audio, decrypted in place
+  MODE_SLAB,  // video, input on the heap, output carved out of the slab
+  MODE_BATCH, // as slab, a fragment of samples per DecryptBatch call
+  MODE_ASYNC  // as slab, queued to the session worker
+};
+
+const char* ModeName(Mode mode) {
+  switch (mode) {
+  case MODE_NEXUS:
+    return "nexus";
+  case MODE_AUDIO:
+    return "audio";
+  case MODE_SLAB:
+    return "slab";
+  case MODE_BATCH:
+    return "batch";
+  case MODE_ASYNC:
+    return "async";
+  default:
+    return "heap";
+  }
+}
+
+struct Worker {
+  CDMi::IMediaKeySession* session;
+  uint8_t keyId[16];
+  std::vector<Sample> samples;
+  std::vector<uint32_t> latencies;
+  uint8_t* input;
+  uint32_t failures;
+  uint32_t mismatches;
+  bool audio;
+  // Asked for SecureRegion descriptors instead of bare tokens.
+  bool regions;
+};
+
+// The output of a sample is the length bytes at offset in the block behind
+// token, whatever way it was decrypted.
+bool Matches(const Sample& sample, NEXUS_MemoryBlockTokenHandle token, uint32_t offset, uint32_t length) {
+  const uint32_t size = static_cast<uint32_t>(sample.clear.size());
+  uint32_t blockSize = 0;
+  const uint8_t* output = Shim::NexusResolve(token, &blockSize);
+  return ((output != nullptr) && (length == size) && (blockSize >= (offset + size)) &&
+      (::memcmp(output + offset, sample.clear.data(), size) == 0));
+}
+
+// Hands a token back the way Decrypt would have handed it out.
+void Release(const Worker& worker, NEXUS_MemoryBlockTokenHandle token, uint32_t offset, uint32_t length) {
+  CDMi::IMediaKeySession* session = worker.session;
+  if (worker.regions == true) {
+    CDMi::SecureRegion region;
+    region.token = token;
+    region.offset = offset;
+    region.length = length;
+    session->ReleaseClearContent(nullptr, 0, sizeof(region), reinterpret_cast<uint8_t*>(&region));
+  } else {
+    session->ReleaseClearContent(nullptr, 0, sizeof(token), reinterpret_cast<uint8_t*>(&token));
+  }
+}
+
+// Goes through the interface an OCDM server would find on the session.
+void RunBatch(Worker& worker, uint32_t iterations) {
+  CDMi::IBatchDecrypt* session = dynamic_cast<CDMi::IBatchDecrypt*>(worker.session);
+
+  if (session == nullptr) {
+    worker.failures += iterations;
+    return;
+  }
+
+  std::vector<CDMi::IBatchDecrypt::Sample> batch(worker.samples.size());
+
+  for (uint32_t iteration = 0; iteration < iterations; iteration += static_cast<uint32_t>(batch.size())) {
+    const uint32_t count = std::min<uint32_t>(static_cast<uint32_t>(batch.size()), iterations - iteration);
+
+    for (uint32_t index = 0; index < count; index++) {
+      // Video input is only read, the output goes to secure memory.
+      const Sample& sample(worker.samples[index]);
+      CDMi::IBatchDecrypt::Sample& entry(batch[index]);
+      entry.data = sample.encrypted.data();
+      entry.length = static_cast<uint32_t>(sample.encrypted.size());
+      entry.iv = sample.iv;
+      entry.ivLength = sizeof(sample.iv);
+      entry.subSampleMapping = (sample.subSamples.empty() ? nullptr : sample.subSamples.data());
+      entry.subSampleMappingCount = static_cast<uint32_t>(sample.subSamples.size());
+      entry.keyId = worker.keyId;
+      entry.keyIdLength = sizeof(worker.keyId);
+      entry.token = nullptr;
+      entry.offset = ~0u;
+      entry.result = CDMi_S_FALSE;
+    }
+    batch.resize(count);
+
+    const auto start = std::chrono::steady_clock::now();
+    session->DecryptBatch(batch);
+    const auto stop = std::chrono::steady_clock::now();
+
+    const uint32_t latency = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count() / count);
+
+    for (uint32_t index = 0; index < count; index++) {
+      const Sample& sample(worker.samples[index]);
+      const CDMi::IBatchDecrypt::Sample& entry(batch[index]);
+
+      worker.latencies[iteration + index] = latency;
+
+      if (entry.result != CDMi_SUCCESS) {
+        worker.failures++;
+      } else if ((iteration == 0) && (Matches(sample, entry.token, entry.offset, entry.length) == false)) {
+        worker.mismatches++;
+      }
+
+      if (entry.token != nullptr) {
+        Release(worker, entry.token, entry.offset, entry.length);
+      }
+    }
+  }
+}
+
+// Collects the results of the async mode. At most one round of samples is in
+// flight, so a sample is known by its input buffer. Every queued sample must
+// be reported exactly once, also the ones DisableAsync cancels.
+class Receiver : public CDMi::IAsyncDecrypt::IDecryptCallback {
+public:
+  Receiver(const Receiver&) = delete;
+  Receiver& operator=(const Receiver&) = delete;
+
+  Receiver(Worker& worker)
+    : _worker(worker)
+    , _slots(worker.samples.size())
+    , _completed(0)
+    , _disabling(false) {
+  }
+  ~Receiver() override {
+  }
+
+public:
+  // Producer side, a slot may only be reused once Completed has passed it.
+  void Queued(uint32_t index, uint32_t iteration) {
+    Slot& slot(_slots[index]);
+    slot.pending = true;
+    slot.iteration = iteration;
+    slot.start = std::chrono::steady_clock::now();
+  }
+  void Dropped(uint32_t index) {
+    _slots[index].pending = false;
+  }
+  inline uint32_t Completed() const {
+    return (_completed.load(std::memory_order_acquire));
+  }
+  inline void Disabling(bool disabling) {
+    _disabling.store(disabling, std::memory_order_relaxed);
+  }
+
+  // Session worker side.
+  void Decrypted(const CDMi::IBatchDecrypt::Sample& result) override {
+    const auto stop = std::chrono::steady_clock::now();
+    uint32_t index = 0;
+    while ((index < _worker.samples.size()) && (_worker.samples[index].encrypted.data() != result.data)) {
+      index++;
+    }
+
+    if ((index == _worker.samples.size()) || (_slots[index].pending == false)) {
+      // Never queued, or reported twice.
+      _worker.mismatches++;
+    } else {
+      Slot& slot(_slots[index]);
+
+      slot.pending = false;
+      _worker.latencies[slot.iteration] = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - slot.start).count());
+
+      if (result.result != CDMi_SUCCESS) {
+        // Cancelled by DisableAsync is not a failure.
+        if (_disabling.load(std::memory_order_relaxed) == false) {
+          _worker.failures++;
+        }
+      } else if ((slot.iteration < _worker.samples.size()) &&
+                 (Matches(_worker.samples[index], result.token, result.offset, result.length) == false)) {
+        _worker.mismatches++;
+      }
+    }
+
+    if (result.token != nullptr) {
+      Release(_worker, result.token, result.offset, result.length);
+    }
+
+    _completed.fetch_add(1, std::memory_order_release);
+  }
+
+private:
+  struct Slot {
+    Slot() : pending(false), iteration(0), start() {
+    }
+
+    bool pending;
+    uint32_t iteration;
+    std::chrono::steady_clock::time_point start;
+  };
+
+  Worker& _worker;
+  std::vector<Slot> _slots;
+  std::atomic<uint32_t> _completed;
+  std::atomic<bool> _disabling;
+};
+
+// The worker counters belong to the session worker while the mode is on, what
+// goes wrong on this side is added once it has stopped.
+void RunAsync(Worker& worker, uint32_t iterations) {
+  CDMi::IAsyncDecrypt* session = dynamic_cast<CDMi::IAsyncDecrypt*>(worker.session);
+
+  if (session == nullptr) {
+    worker.failures += iterations;
+    return;
+  }
+
+  const uint32_t window = static_cast<uint32_t>(worker.samples.size());
+  Receiver receiver(worker);
+  uint32_t failures = 0;
+  uint32_t mismatches = 0;
+  uint32_t queued = 0;
+  uint32_t iteration = 0;
+  bool enabled = (session->EnableAsync(&receiver) == CDMi_SUCCESS);
+
+  for (; (enabled == true) && (iteration < iterations); iteration++) {
+    const uint32_t index = iteration % window;
+    const Sample& sample(worker.samples[index]);
+
+    // Halfway, switch the mode off with samples still queued and back on.
+    // DisableAsync returns once the cancelled ones have been reported.
+    if (iteration == (iterations / 2)) {
+      receiver.Disabling(true);
+      session->DisableAsync();
+      receiver.Disabling(false);
+      if (receiver.Completed() != queued) {
+        mismatches += queued - receiver.Completed();
+        queued = receiver.Completed();
+      }
+      enabled = (session->EnableAsync(&receiver) == CDMi_SUCCESS);
+      if (enabled == false) {
+        break;
+      }
+    }
+
+    // Reported in order, so the slot is free once the window moved past it.
+    while ((queued - receiver.Completed()) >= window) {
+      std::this_thread::yield();
+    }
+
+    CDMi::IBatchDecrypt::Sample entry;
+    entry.data = sample.encrypted.data();
+    entry.length = static_cast<uint32_t>(sample.encrypted.size());
+    entry.iv = sample.iv;
+    entry.ivLength = sizeof(sample.iv);
+    entry.subSampleMapping = (sample.subSamples.empty() ? nullptr : sample.subSamples.data());
+    entry.subSampleMappingCount = static_cast<uint32_t>(sample.subSamples.size());
+    entry.keyId = worker.keyId;
+    entry.keyIdLength = sizeof(worker.keyId);
+    entry.token = nullptr;
+    entry.offset = ~0u;
+    entry.result = CDMi_S_FALSE;
+
+    receiver.Queued(index, iteration);
+    if (session->DecryptAsync(entry) == CDMi_SUCCESS) {
+      queued++;
+    } else {
+      receiver.Dropped(index);
+      failures++;
+    }
+  }
+
+  if (enabled == true) {
+    while (receiver.Completed() != queued) {
+      std::this_thread::yield();
+    }
+    session->DisableAsync();
+  }
+
+  // Late or extra reports would show up here.
+  if (receiver.Completed() != queued) {
+    mismatches++;
+  }
+
+  // Whatever could not be queued at all failed too.
+  worker.failures += failures + (iterations - iteration);
+  worker.mismatches += mismatches;
+}
+
+void Run(Worker& worker, uint32_t iterations) {
+  for (uint32_t iteration = 0; iteration < iterations; iteration++) {
+    const Sample& sample(worker.samples[iteration % worker.samples.size()]);
+    const uint32_t size = static_cast<uint32_t>(sample.encrypted.size());
+    uint32_t opaqueSize = 0;
+    uint8_t* opaque = nullptr;
+
+    // Decrypt overwrites the input with the token or the clear audio,
+    // restore it (not timed).
+    ::memcpy(worker.input, sample.encrypted.data(), size);
+
+    const auto start = std::chrono::steady_clock::now();
+    CDMi::CDMi_RESULT result = worker.session->Decrypt(nullptr, 0,
+        sample.subSamples.empty() ? nullptr : sample.subSamples.data(), static_cast<uint32_t>(sample.subSamples.size()),
+        sample.iv, sizeof(sample.iv), worker.input, size, &opaqueSize, &opaque, 16, worker.keyId, false);
+    const auto stop = std::chrono::steady_clock::now();
+
+    worker.latencies[iteration] = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+
+    if (result != CDMi_SUCCESS) {
+      worker.failures++;
+    } else if ((iteration < worker.samples.size()) && (worker.audio == true)) {
+      if ((opaque != worker.input) || (opaqueSize != size) || (::memcmp(opaque, sample.clear.data(), size) != 0)) {
+        worker.mismatches++;
+      }
+    } else if (iteration < worker.samples.size()) {
+      CDMi::SecureRegion region;
+      region.offset = 0;
+      region.length = size;
+      if (opaqueSize == sizeof(region)) {
+        ::memcpy(&region, opaque, sizeof(region));
+      } else {
+        ::memcpy(&region.token, opaque, sizeof(region.token));
+      }
+      if (Matches(sample, region.token, region.offset, region.length) == false) {
+        worker.mismatches++;
+      }
+    }
+
+    if (opaqueSize != 0) {
+      worker.session->ReleaseClearContent(nullptr, 0, opaqueSize, opaque);
+    }
+  }
+}
+
+void Measure(CDMi::IMediaKeys* system, uint32_t sampleSize, uint32_t sessions, bool subSamples, Mode mode, uint32_t iterations) {
+  if ((g_mode != nullptr) && (::strcmp(g_mode, ModeName(mode)) != 0)) {
+    return;
+  }
+
+  std::mt19937 random(sampleSize ^ sessions);
+
+  const bool regions = ((mode == MODE_SLAB) || (mode == MODE_BATCH) || (mode == MODE_ASYNC));
+  const std::string cdmData(regions ? "video/mp4; secure-region" : "");
+
+  CDMi::SecureSlab::Reserve(regions ? SlabReserve : 0);
+  std::vector<Worker> workers(sessions);
+  std::vector<Bench::SessionCallback*> callbacks;
+
+  for (uint32_t index = 0; index < sessions; index++) {
+    Worker& worker(workers[index]);
+    for (uint8_t& byte : worker.keyId) {
+      byte = static_cast<uint8_t>(random());
+    }
+
+    const std::string initData(Bench::InitData(worker.keyId, mode == MODE_AUDIO));
+    worker.session = nullptr;
+    system->CreateMediaKeySession(Bench::KeySystem, 0, "cenc", reinterpret_cast<const uint8_t*>(initData.data()),
+        static_cast<uint32_t>(initData.size()), reinterpret_cast<const uint8_t*>(cdmData.data()),
+        static_cast<uint32_t>(cdmData.size()), &worker.session);
+    if (worker.session == nullptr) {
+      printf("Could not create a session\n");
+      exit(1);
+    }
+
+    callbacks.push_back(new Bench::SessionCallback());
+    worker.session->Run(callbacks.back());
+
+    const std::string license(Shim::LicenseResponse(worker.keyId, 1));
+    worker.session->Update(reinterpret_cast<const uint8_t*>(license.data()), static_cast<uint32_t>(license.size()));
+
+    worker.samples.resize(SamplesPerSession);
+    for (Sample& sample : worker.samples) {
+      Prepare(sample, sampleSize, subSamples, worker.keyId, random);
+    }
+    worker.latencies.resize(iterations);
+    worker.failures = 0;
+    worker.mismatches = 0;
+    worker.audio = (mode == MODE_AUDIO);
+    worker.regions = regions;
+
+    if (mode == MODE_NEXUS) {
+      void* memory = nullptr;
+      NEXUS_Memory_Allocate(sampleSize, nullptr, &memory);
+      worker.input = static_cast<uint8_t*>(memory);
+    } else {
+      worker.input = static_cast<uint8_t*>(::malloc(sampleSize));
+    }
+  }
+
+  Shim::NexusCounters before;
+  Shim::NexusCounters after;
+  Shim::NexusSnapshot(before);
+  const uint64_t heapBefore = g_heapAllocations.load();
+  const auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> threads;
+  for (Worker& worker : workers) {
+    threads.push_back(std::thread(mode == MODE_BATCH ? RunBatch : (mode == MODE_ASYNC ? RunAsync : Run), std::ref(worker), iterations));
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  const auto stop = std::chrono::steady_clock::now();
+  const uint64_t heapAllocations = g_heapAllocations.load() - heapBefore - sessions;
+  Shim::NexusSnapshot(after);
+
+  std::vector<uint32_t> latencies;
+  uint32_t failures = 0;
+  uint32_t mismatches = 0;
+  for (Worker& worker : workers) {
+    latencies.insert(latencies.end(), worker.latencies.begin(), worker.latencies.end());
+    failures += worker.failures;
+    mismatches += worker.mismatches;
+    system->DestroyMediaKeySession(worker.session);
+    if (mode == MODE_NEXUS) {
+      NEXUS_Memory_Free(worker.input);
+    } else {
+      ::free(worker.input);
+    }
+  }
+  for (Bench::SessionCallback* callback : callbacks) {
+    delete callback;
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+  const double samples = static_cast<double>(latencies.size());
+  const double seconds = std::chrono::duration<double>(stop - start).count();
+  const uint64_t nexusAllocations = (after.memoryAllocations - before.memoryAllocations) + (after.blockAllocations - before.blockAllocations);
+
+  printf("%8u %8u %-5s %-5s %12.0f %10.1f %10.1f %8.3f %8.3f %6u %6u\n",
+      sampleSize, sessions, subSamples ? "yes" : "no", ModeName(mode),
+      samples / seconds,
+      latencies[latencies.size() / 2] / 1000.0,
+      latencies[(latencies.size() * 99) / 100] / 1000.0,
+      heapAllocations / samples, nexusAllocations / samples,
+      failures, mismatches);
+}
+
+void Report(const CDMi::IDecryptStatistics& source) {
+  CDMi::DecryptStatistics statistics;
+  source.Statistics(statistics);
+
+  printf("\nDecrypted %llu samples, %llu bytes, %llu zero-copy, %llu routed, %llu secure allocations\n",
+      static_cast<unsigned long long>(statistics.samples), static_cast<unsigned long long>(statistics.bytes),
+      static_cast<unsigned long long>(statistics.zeroCopySamples), static_cast<unsigned long long>(statistics.routedSamples),
+      static_cast<unsigned long long>(statistics.secureAllocations));
+
+  printf("Secure tokens: %llu abandoned by the consumer\n", static_cast<unsigned long long>(statistics.abandonedTokens));
+
+  printf("Secure slab: %llu samples did not fit\n", static_cast<unsigned long long>(statistics.slabFallbacks));
+
+  printf("Secure copy: %llu clear bytes moved by DMA\n", static_cast<unsigned long long>(statistics.secureCopyBytes));
+
+  printf("Input staging: %llu grows, %llu shrinks, %llu bytes held\n",
+      static_cast<unsigned long long>(statistics.inputGrows), static_cast<unsigned long long>(statistics.inputShrinks),
+      static_cast<unsigned long long>(statistics.inputCapacity));
+
+  printf("%-12s %10s %10s %10s %10s %10s %10s\n", "stage", "count", "p50 us", "p90 us", "p99 us", "p99.9 us", "max us");
+  for (uint8_t index = 0; index < CDMi::DecryptStatistics::STAGE_COUNT; index++) {
+    const CDMi::DecryptStatistics::Latency& latency(statistics.latencies[index]);
+    printf("%-12s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+        CDMi::DecryptStatistics::StageName(static_cast<CDMi::DecryptStatistics::Stage>(index)),
+        static_cast<unsigned long long>(latency.count), latency.p50 / 1000.0, latency.p90 / 1000.0,
+        latency.p99 / 1000.0, latency.p999 / 1000.0, latency.max / 1000.0);
+  }
+  for (uint8_t index = 0; index < CDMi::DecryptStatistics::FAILURE_COUNT; index++) {
+    if (statistics.failures[index] != 0) {
+      printf("failed %s: %llu\n", CDMi::DecryptStatistics::FailureName(static_cast<CDMi::DecryptStatistics::Failure>(index)),
+          static_cast<unsigned long long>(statistics.failures[index]));
+    }
+  }
+}
+
+void Report(const CDMi::IStartupStatistics& source) {
+  CDMi::StartupStatistics statistics;
+  source.Statistics(statistics);
+
+  printf("\nStartup: ready %s after %.1f ms, %u sessions waited up to %.1f ms\n", statistics.ready ? "yes" : "no",
+      statistics.total / 1000000.0, statistics.waits, statistics.waited / 1000000.0);
+  for (uint8_t index = 0; index < CDMi::StartupStatistics::PHASE_COUNT; index++) {
+    printf("%-12s %10.1f us\n", CDMi::StartupStatistics::PhaseName(static_cast<CDMi::StartupStatistics::Phase>(index)),
+        statistics.phases[index] / 1000.0);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const uint32_t iterations = (argc > 1 ? static_cast<uint32_t>(atoi(argv[1])) : 2000);
+  g_mode = (argc > 2 ? argv[2] : nullptr);
+  const uint32_t sampleSizes[] = { 1024, 16 * 1024, 128 * 1024, 1024 * 1024 };
+  const uint32_t sessionCounts[] = { 1, 2, 4 };
+
+  CDMi::ISystemFactory* factory = GetSystemFactory();
+  factory->Initialize(nullptr, "{}");
+  CDMi::IMediaKeys* system = factory->Instance();
+
+  printf("%8s %8s %-5s %-5s %12s %10s %10s %8s %8s %6s %6s\n",
+      "size", "sessions", "subs", "mode", "samples/s", "p50 us", "p99 us", "heap/op", "nexus/op", "fail", "wrong");
+
+  for (const uint32_t sampleSize : sampleSizes) {
+    for (const uint32_t sessions : sessionCounts) {
+      for (const bool subSamples : { false, true }) {
+        Measure(system, sampleSize, sessions, subSamples, MODE_HEAP, iterations);
+      }
+      Measure(system, sampleSize, sessions, true, MODE_NEXUS, iterations);
+      Measure(system, sampleSize, sessions, true, MODE_SLAB, iterations);
+      Measure(system, sampleSize, sessions, true, MODE_BATCH, iterations);
+      Measure(system, sampleSize, sessions, true, MODE_ASYNC, iterations);
+      if (sampleSize <= (16 * 1024)) {
+        Measure(system, sampleSize, sessions, false, MODE_AUDIO, iterations);
+      }
+    }
+  }
+
+  const CDMi::IDecryptStatistics* statistics = dynamic_cast<const CDMi::IDecryptStatistics*>(system);
+  if (statistics != nullptr) {
+    Report(*statistics);
+  }
+
+  const CDMi::IStartupStatistics* startup = dynamic_cast<const CDMi::IStartupStatistics*>(system);
+  if (startup != nullptr) {
+    Report(*startup);
+  }
+
+  return (0);
+}
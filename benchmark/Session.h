@@ -0,0 +1,108 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <cdmi.h>
+
+#include <atomic>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+namespace Bench {
+
+static const char KeySystem[] = "com.widevine.alpha";
+
+class SessionCallback : public CDMi::IMediaKeySessionCallback {
+public:
+  SessionCallback(const SessionCallback&) = delete;
+  SessionCallback& operator=(const SessionCallback&) = delete;
+
+  SessionCallback()
+    : _messages(0)
+    , _keyUpdates(0)
+    , _errors(0) {
+  }
+  ~SessionCallback() override {
+  }
+
+public:
+  void OnKeyMessage(const uint8_t*, uint32_t, char*) override {
+    _messages++;
+  }
+  void OnError(int16_t, CDMi::CDMi_RESULT, const char* message) override {
+    printf("Session error: %s\n", message);
+    _errors++;
+  }
+  void OnKeyStatusUpdate(const char*, const uint8_t*, const uint8_t) override {
+    _keyUpdates++;
+  }
+  void OnKeyStatusesUpdated() const override {
+  }
+
+  inline uint32_t Messages() const {
+    return (_messages);
+  }
+  inline uint32_t KeyUpdates() const {
+    return (_keyUpdates);
+  }
+  inline uint32_t Errors() const {
+    return (_errors);
+  }
+
+private:
+  std::atomic<uint32_t> _messages;
+  std::atomic<uint32_t> _keyUpdates;
+  std::atomic<uint32_t> _errors;
+};
+
+// A Widevine PSSH box (version 0) listing a single key id, optionally marked
+// as an audio track.
+inline std::string InitData(const uint8_t keyId[16], bool audio = false) {
+  static const uint8_t systemId[] = {
+    0xED, 0xEF, 0x8B, 0xA9, 0x79, 0xD6, 0x4A, 0xCE, 0xA3, 0xC8, 0x27, 0xDC, 0xD5, 0x1D, 0x21, 0xED
+  };
+  std::string data;
+  data += '\x12';
+  data += '\x10';
+  data.append(reinterpret_cast<const char*>(keyId), 16);
+  if (audio == true) {
+    data += '\x2A';
+    data += '\x05';
+    data += "AUDIO";
+  }
+
+  std::string box;
+  const uint32_t size = 32 + static_cast<uint32_t>(data.size());
+  const uint32_t fields[] = { size, 0x70737368, 0 };
+  for (const uint32_t field : fields) {
+    for (int shift = 24; shift >= 0; shift -= 8) {
+      box += static_cast<char>((field >> shift) & 0xFF);
+    }
+  }
+  box.append(reinterpret_cast<const char*>(systemId), sizeof(systemId));
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    box += static_cast<char>((data.size() >> shift) & 0xFF);
+  }
+  return (box + data);
+}
+
+}  // namespace Bench
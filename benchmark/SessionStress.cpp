@@ -0,0 +1,193 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Opens and closes sessions from several threads at once while another thread
+// keeps firing key status events at a set of long lived sessions.
+//
+//   widevine-session-stress [sessions per thread]
+
+#include "Session.h"
+#include "fake/FakeCdm.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const uint32_t LongLivedSessions = 4;
+
+struct Worker {
+  uint32_t index;
+  std::vector<uint32_t> creates;
+  std::vector<uint32_t> destroys;
+  uint32_t failures;
+};
+
+inline uint32_t Elapsed(const std::chrono::steady_clock::time_point& start) {
+  return (static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count()));
+}
+
+void KeyId(uint32_t thread, uint32_t index, uint8_t keyId[16]) {
+  ::memset(keyId, 0x5A, 16);
+  ::memcpy(&keyId[0], &thread, sizeof(thread));
+  ::memcpy(&keyId[4], &index, sizeof(index));
+}
+
+CDMi::IMediaKeySession* Open(CDMi::IMediaKeys* system, const uint8_t keyId[16], Bench::SessionCallback& callback) {
+  CDMi::IMediaKeySession* session = nullptr;
+  const std::string initData(Bench::InitData(keyId));
+
+  system->CreateMediaKeySession(Bench::KeySystem, 0, "cenc", reinterpret_cast<const uint8_t*>(initData.data()),
+      static_cast<uint32_t>(initData.size()), nullptr, 0, &session);
+  if (session != nullptr) {
+    session->Run(&callback);
+  }
+  return (session);
+}
+
+void License(CDMi::IMediaKeySession* session, const uint8_t keyId[16]) {
+  const std::string license(Shim::LicenseResponse(keyId, 1));
+  session->Update(reinterpret_cast<const uint8_t*>(license.data()), static_cast<uint32_t>(license.size()));
+}
+
+void Run(CDMi::IMediaKeys* system, Worker& worker, uint32_t count) {
+  for (uint32_t index = 0; index < count; index++) {
+    uint8_t keyId[16];
+    Bench::SessionCallback callback;
+    KeyId(worker.index + 1, index, keyId);
+
+    auto start = std::chrono::steady_clock::now();
+    CDMi::IMediaKeySession* session = Open(system, keyId, callback);
+    worker.creates[index] = Elapsed(start);
+
+    if (session == nullptr) {
+      worker.failures++;
+      continue;
+    }
+
+    // Key statuses are reported asynchronously, the session may be gone by then.
+    License(session, keyId);
+    if (callback.Messages() != 1) {
+      worker.failures++;
+    }
+
+    start = std::chrono::steady_clock::now();
+    system->DestroyMediaKeySession(session);
+    worker.destroys[index] = Elapsed(start);
+  }
+}
+
+uint32_t Percentile(std::vector<uint32_t>& values, uint32_t percent) {
+  std::sort(values.begin(), values.end());
+  return (values.empty() ? 0 : values[(values.size() * percent) / 100]);
+}
+
+void Measure(CDMi::IMediaKeys* system, uint32_t threads, uint32_t count) {
+  // Key rotation on sessions that stay open, racing creation and teardown.
+  Bench::SessionCallback callbacks[LongLivedSessions];
+  CDMi::IMediaKeySession* sessions[LongLivedSessions];
+  uint8_t keyIds[LongLivedSessions][16];
+
+  for (uint32_t index = 0; index < LongLivedSessions; index++) {
+    KeyId(0, index, keyIds[index]);
+    sessions[index] = Open(system, keyIds[index], callbacks[index]);
+    if (sessions[index] == nullptr) {
+      printf("Could not create a session\n");
+      exit(1);
+    }
+  }
+
+  std::atomic<bool> running(true);
+  uint32_t rotations = 0;
+  std::thread rotator([&]() {
+    while (running == true) {
+      License(sessions[rotations % LongLivedSessions], keyIds[rotations % LongLivedSessions]);
+      rotations++;
+    }
+  });
+
+  std::vector<Worker> workers(threads);
+  std::vector<std::thread> pool;
+  const auto start = std::chrono::steady_clock::now();
+
+  for (uint32_t index = 0; index < threads; index++) {
+    workers[index].index = index;
+    workers[index].creates.resize(count);
+    workers[index].destroys.resize(count);
+    workers[index].failures = 0;
+    pool.push_back(std::thread(Run, system, std::ref(workers[index]), count));
+  }
+  for (std::thread& thread : pool) {
+    thread.join();
+  }
+
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  running = false;
+  rotator.join();
+
+  uint32_t updates = 0;
+  for (uint32_t index = 0; index < LongLivedSessions; index++) {
+    updates += callbacks[index].KeyUpdates();
+    system->DestroyMediaKeySession(sessions[index]);
+  }
+
+  std::vector<uint32_t> creates;
+  std::vector<uint32_t> destroys;
+  uint32_t failures = 0;
+  for (Worker& worker : workers) {
+    creates.insert(creates.end(), worker.creates.begin(), worker.creates.end());
+    destroys.insert(destroys.end(), worker.destroys.begin(), worker.destroys.end());
+    failures += worker.failures;
+  }
+
+  printf("%8u %10u %12.0f %10.1f %10.1f %10.1f %10.1f %10u %10u %6u\n",
+      threads, threads * count, (threads * count) / seconds,
+      Percentile(creates, 50) / 1000.0, Percentile(creates, 99) / 1000.0,
+      Percentile(destroys, 50) / 1000.0, Percentile(destroys, 99) / 1000.0,
+      rotations, updates, failures);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const uint32_t count = (argc > 1 ? static_cast<uint32_t>(atoi(argv[1])) : 2000);
+  const uint32_t threadCounts[] = { 1, 2, 4, 8 };
+
+  CDMi::ISystemFactory* factory = GetSystemFactory();
+  factory->Initialize(nullptr, "{}");
+  CDMi::IMediaKeys* system = factory->Instance();
+
+  printf("%8s %10s %12s %10s %10s %10s %10s %10s %10s %6s\n",
+      "threads", "sessions", "sessions/s", "create p50", "create p99", "close p50", "close p99",
+      "rotations", "updates", "fail");
+
+  for (const uint32_t threads : threadCounts) {
+    Measure(system, threads, count);
+  }
+
+  return (0);
+}
@@ -0,0 +1,291 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Stand-in for the Widevine CE CDM: license exchange without a server and
+// decryption in the clear with OpenSSL, enough to drive the plugin's decrypt
+// path on any Linux box.
+
+#include "FakeCdm.h"
+#include "string_conversions.h"
+
+#include <openssl/evp.h>
+
+#include <atomic>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+
+namespace Shim {
+
+void ContentKey(const uint8_t* keyId, uint32_t keyIdLength, uint8_t key[16]) {
+  for (uint8_t index = 0; index < 16; index++) {
+    key[index] = (index < keyIdLength ? keyId[index] : 0) ^ 0xA5;
+  }
+}
+
+std::string LicenseResponse(const uint8_t* keyIds, uint32_t count) {
+  return (std::string(reinterpret_cast<const char*>(keyIds), count * 16));
+}
+
+bool Cipher(bool encrypt, widevine::Cdm::EncryptionScheme scheme, const widevine::Cdm::Pattern& pattern,
+    const uint8_t key[16], const uint8_t iv[16], uint32_t blockOffset,
+    const uint8_t* input, uint8_t* output, uint32_t length) {
+
+  if (scheme == widevine::Cdm::kClear) {
+    ::memmove(output, input, length);
+    return (true);
+  }
+
+  EVP_CIPHER_CTX* context = EVP_CIPHER_CTX_new();
+  const EVP_CIPHER* cipher = (scheme == widevine::Cdm::kAesCbc ? EVP_aes_128_cbc() : EVP_aes_128_ctr());
+  bool result = (EVP_CipherInit_ex(context, cipher, nullptr, key, iv, encrypt ? 1 : 0) == 1);
+  EVP_CIPHER_CTX_set_padding(context, 0);
+
+  int produced = 0;
+
+  // Resume a CTR keystream in the middle of a block.
+  if ((result == true) && (scheme == widevine::Cdm::kAesCtr) && (blockOffset != 0)) {
+    uint8_t scratch[16];
+    result = (EVP_CipherUpdate(context, scratch, &produced, scratch, blockOffset) == 1);
+  }
+
+  const uint32_t crypt = pattern.encrypted_blocks;
+  const uint32_t skip = pattern.clear_blocks;
+  uint32_t offset = 0;
+
+  if (crypt == 0) {
+    // No pattern: CTR covers everything, CBC every full block.
+    const uint32_t covered = (scheme == widevine::Cdm::kAesCbc ? (length & ~15u) : length);
+    result = result && (EVP_CipherUpdate(context, output, &produced, input, covered) == 1);
+    offset = covered;
+  } else {
+    while ((result == true) && ((length - offset) >= 16)) {
+      const uint32_t blocks = (length - offset) / 16;
+      const uint32_t encrypted = (blocks < crypt ? blocks : crypt) * 16;
+      result = (EVP_CipherUpdate(context, &output[offset], &produced, &input[offset], encrypted) == 1);
+      offset += encrypted;
+
+      const uint32_t clear = ((length - offset) / 16 < skip ? (length - offset) / 16 : skip) * 16;
+      ::memmove(&output[offset], &input[offset], clear);
+      offset += clear;
+    }
+  }
+
+  ::memmove(&output[offset], &input[offset], length - offset);
+
+  EVP_CIPHER_CTX_free(context);
+  return (result);
+}
+
+}  // namespace Shim
+
+namespace wvcdm {
+
+std::string a2bs_hex(const std::string& hex) {
+  std::string result;
+  for (std::string::size_type index = 0; (index + 1) < hex.size(); index += 2) {
+    result += static_cast<char>(std::stoi(hex.substr(index, 2), nullptr, 16));
+  }
+  return (result);
+}
+
+}  // namespace wvcdm
+
+namespace widevine {
+
+namespace {
+
+class FakeCdm : public Cdm {
+private:
+  struct Key {
+    std::string id;
+    uint8_t value[16];
+    KeyStatus status;
+    std::string session;
+  };
+
+  // Linear on purpose: a handful of keys, and lookups must not allocate.
+  typedef std::vector<Key> KeyMap;
+
+public:
+  FakeCdm(const FakeCdm&) = delete;
+  FakeCdm& operator=(const FakeCdm&) = delete;
+
+  FakeCdm(IEventListener* listener)
+    : _lock()
+    , _listener(listener)
+    , _sessions()
+    , _keys() {
+  }
+  ~FakeCdm() override {
+  }
+
+public:
+  Status setServiceCertificate(const std::string&) override {
+    return (kSuccess);
+  }
+
+  Status createSession(SessionType, std::string* session_id) override {
+    std::lock_guard<std::mutex> guard(_lock);
+    *session_id = "fake-" + std::to_string(_nextSession++);
+    _sessions[*session_id] = true;
+    return (kSuccess);
+  }
+
+  Status generateRequest(const std::string& session_id, InitDataType, const std::string&) override {
+    if (Exists(session_id) == false) {
+      return (kSessionNotFound);
+    }
+    _listener->onMessage(session_id, kLicenseRequest, "fake-license-request");
+    return (kSuccess);
+  }
+
+  Status load(const std::string& session_id) override {
+    return (Exists(session_id) ? kSuccess : kSessionNotFound);
+  }
+
+  Status update(const std::string& session_id, const std::string& response) override {
+    if ((Exists(session_id) == false) || ((response.size() % 16) != 0)) {
+      return (Exists(session_id) ? kTypeError : kSessionNotFound);
+    }
+    {
+      std::lock_guard<std::mutex> guard(_lock);
+      for (std::string::size_type offset = 0; offset < response.size(); offset += 16) {
+        const std::string id(response.substr(offset, 16));
+        KeyMap::iterator index(Find(reinterpret_cast<const uint8_t*>(id.data()), 16));
+        if (index == _keys.end()) {
+          index = _keys.insert(_keys.end(), Key());
+          index->id = id;
+        }
+        Key& key(*index);
+        Shim::ContentKey(reinterpret_cast<const uint8_t*>(&response[offset]), 16, key.value);
+        key.status = kUsable;
+        key.session = session_id;
+      }
+    }
+    _listener->onKeyStatusesChange(session_id);
+    return (kSuccess);
+  }
+
+  Status getExpiration(const std::string& session_id, int64_t* expiration) override {
+    *expiration = -1;
+    return (Exists(session_id) ? kSuccess : kSessionNotFound);
+  }
+
+  Status getKeyStatuses(const std::string& session_id, KeyStatusMap* key_statuses) override {
+    std::lock_guard<std::mutex> guard(_lock);
+    key_statuses->clear();
+    for (const auto& entry : _keys) {
+      if (entry.session == session_id) {
+        (*key_statuses)[entry.id] = entry.status;
+      }
+    }
+    return (_sessions.find(session_id) != _sessions.end() ? kSuccess : kSessionNotFound);
+  }
+
+  Status close(const std::string& session_id) override {
+    std::lock_guard<std::mutex> guard(_lock);
+    DropKeys(session_id);
+    return (_sessions.erase(session_id) != 0 ? kSuccess : kSessionNotFound);
+  }
+
+  Status remove(const std::string& session_id) override {
+    {
+      std::lock_guard<std::mutex> guard(_lock);
+      for (auto& entry : _keys) {
+        if (entry.session == session_id) {
+          entry.status = kReleased;
+        }
+      }
+    }
+    _listener->onRemoveComplete(session_id);
+    return (kSuccess);
+  }
+
+  Status decrypt(const InputBuffer& input, const OutputBuffer& output) override {
+    uint8_t key[16];
+
+    if ((output.data_offset + input.data_length) > output.data_length) {
+      return (kRangeError);
+    }
+
+    if (input.encryption_scheme != kClear) {
+      std::lock_guard<std::mutex> guard(_lock);
+      KeyMap::const_iterator index(Find(input.key_id, input.key_id_length));
+      if ((index == _keys.end()) || (index->status != kUsable)) {
+        return (kNoKey);
+      }
+      ::memcpy(key, index->value, sizeof(key));
+    }
+
+    bool result = Shim::Cipher(false, input.encryption_scheme, input.pattern, key, input.iv, input.block_offset,
+        input.data, output.data + output.data_offset, input.data_length);
+
+    return (result ? kSuccess : kDecryptError);
+  }
+
+private:
+  bool Exists(const std::string& session_id) {
+    std::lock_guard<std::mutex> guard(_lock);
+    return (_sessions.find(session_id) != _sessions.end());
+  }
+
+  KeyMap::iterator Find(const uint8_t* keyId, uint32_t length) {
+    KeyMap::iterator index(_keys.begin());
+    while ((index != _keys.end()) &&
+           ((index->id.size() != length) || (::memcmp(index->id.data(), keyId, length) != 0))) {
+      index++;
+    }
+    return (index);
+  }
+
+  void DropKeys(const std::string& session_id) {
+    KeyMap::iterator index(_keys.begin());
+    while (index != _keys.end()) {
+      if (index->session == session_id) {
+        index = _keys.erase(index);
+      } else {
+        index++;
+      }
+    }
+  }
+
+private:
+  std::mutex _lock;
+  IEventListener* _listener;
+  std::map<std::string, bool> _sessions;
+  KeyMap _keys;
+  // Like the real CDM, session ids are unique over all instances.
+  static std::atomic<uint32_t> _nextSession;
+};
+
+/* static */ std::atomic<uint32_t> FakeCdm::_nextSession(1);
+
+}  // namespace
+
+/* static */ Cdm::Status Cdm::initialize(SecureOutputType, const ClientInfo&, IStorage*, IClock*, ITimer*, LogLevel) {
+  return (kSuccess);
+}
+
+/* static */ Cdm* Cdm::create(IEventListener* listener, IStorage*, bool) {
+  return (new FakeCdm(listener));
+}
+
+}  // namespace widevine
@@ -0,0 +1,42 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include "cdm.h"
+
+#include <stdint.h>
+
+namespace Shim {
+
+// Content key the stand-in CDM uses for a key id; the benchmark encrypts its
+// samples with the same key.
+void ContentKey(const uint8_t* keyId, uint32_t keyIdLength, uint8_t key[16]);
+
+// AES over one contiguous range following the CENC rules for the scheme and
+// crypt:skip pattern. Bytes that the pattern leaves clear are copied.
+bool Cipher(bool encrypt, widevine::Cdm::EncryptionScheme scheme, const widevine::Cdm::Pattern& pattern,
+    const uint8_t key[16], const uint8_t iv[16], uint32_t blockOffset,
+    const uint8_t* input, uint8_t* output, uint32_t length);
+
+// A license response the stand-in CDM accepts: the key ids, back to back.
+std::string LicenseResponse(const uint8_t* keyIds, uint32_t count);
+
+}  // namespace Shim
@@ -0,0 +1,253 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "NexusShim.h"
+#include "nexus_dma.h"
+#include "nexus_platform.h"
+#include "nxclient.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdlib.h>
+#include <string.h>
+
+struct NEXUS_MemoryBlock {
+  uint8_t* data;
+  size_t size;
+  uint32_t locks;
+};
+
+struct NEXUS_DmaJob {
+  NEXUS_DmaJobSettings settings;
+  NEXUS_DmaJobState state;
+};
+
+namespace {
+
+std::mutex g_lock;
+std::map<uintptr_t, size_t> g_memory;
+std::set<NEXUS_MemoryBlockHandle> g_blocks;
+
+std::atomic<uint64_t> g_memoryAllocations(0);
+std::atomic<uint64_t> g_blockAllocations(0);
+std::atomic<uint64_t> g_tokenCount(0);
+std::atomic<uint64_t> g_liveBlocks(0);
+std::atomic<uint64_t> g_dmaBlocks(0);
+std::atomic<uint64_t> g_dmaBytes(0);
+
+// Larger transfers complete through the callback, like a queued hardware
+// job. It fires before ProcessBlocks returns, the most awkward order a
+// caller can see.
+constexpr size_t QueuedDmaSize = 64 * 1024;
+
+// Any non-null value will do, the shim has a single heap.
+NEXUS_HeapHandle const g_secureHeap = reinterpret_cast<NEXUS_HeapHandle>(0x5EC);
+NEXUS_DmaHandle const g_dma = reinterpret_cast<NEXUS_DmaHandle>(0xD3A);
+
+// Tokens are the block address with the low bit set. That is good enough
+// here and keeps the shim from allocating on the decrypt path.
+inline NEXUS_MemoryBlockTokenHandle TokenOf(NEXUS_MemoryBlockHandle block) {
+  return (reinterpret_cast<NEXUS_MemoryBlockTokenHandle>(reinterpret_cast<uintptr_t>(block) | 1));
+}
+
+inline NEXUS_MemoryBlockHandle BlockOf(NEXUS_MemoryBlockTokenHandle token) {
+  return (reinterpret_cast<NEXUS_MemoryBlockHandle>(reinterpret_cast<uintptr_t>(token) & ~static_cast<uintptr_t>(1)));
+}
+
+}  // namespace
+
+namespace Shim {
+
+void NexusSnapshot(NexusCounters& counters) {
+  counters.memoryAllocations = g_memoryAllocations;
+  counters.blockAllocations = g_blockAllocations;
+  counters.tokens = g_tokenCount;
+  counters.liveBlocks = g_liveBlocks;
+  counters.dmaBlocks = g_dmaBlocks;
+  counters.dmaBytes = g_dmaBytes;
+}
+
+const uint8_t* NexusResolve(NEXUS_MemoryBlockTokenHandle token, uint32_t* size) {
+  NEXUS_MemoryBlockHandle block = BlockOf(token);
+  std::lock_guard<std::mutex> guard(g_lock);
+  if (g_blocks.find(block) == g_blocks.end()) {
+    return (nullptr);
+  }
+  *size = static_cast<uint32_t>(block->size);
+  return (block->data);
+}
+
+}  // namespace Shim
+
+extern "C" {
+
+NEXUS_Error NEXUS_Memory_Allocate(size_t numBytes, const NEXUS_MemoryAllocationSettings*, void** ppMemory) {
+  *ppMemory = ::malloc(numBytes);
+  if (*ppMemory == nullptr) {
+    return (NEXUS_NOT_AVAILABLE);
+  }
+  g_memoryAllocations++;
+  std::lock_guard<std::mutex> guard(g_lock);
+  g_memory[reinterpret_cast<uintptr_t>(*ppMemory)] = numBytes;
+  return (NEXUS_SUCCESS);
+}
+
+void NEXUS_Memory_Free(void* pMemory) {
+  if (pMemory != nullptr) {
+    {
+      std::lock_guard<std::mutex> guard(g_lock);
+      g_memory.erase(reinterpret_cast<uintptr_t>(pMemory));
+    }
+    ::free(pMemory);
+  }
+}
+
+NEXUS_Addr NEXUS_AddrToOffset(const void* pMemory) {
+  const uintptr_t address = reinterpret_cast<uintptr_t>(pMemory);
+  std::lock_guard<std::mutex> guard(g_lock);
+  std::map<uintptr_t, size_t>::const_iterator index(g_memory.upper_bound(address));
+  if (index == g_memory.begin()) {
+    return (0);
+  }
+  --index;
+  return ((address < (index->first + index->second)) ? static_cast<NEXUS_Addr>(address) : 0);
+}
+
+void NEXUS_FlushCache(const void*, size_t) {
+}
+
+NEXUS_HeapHandle NEXUS_Heap_Lookup(NEXUS_HeapLookupType) {
+  return (g_secureHeap);
+}
+
+NEXUS_MemoryBlockHandle NEXUS_MemoryBlock_Allocate(NEXUS_HeapHandle, size_t numBytes, size_t,
+    const NEXUS_MemoryBlockAllocationSettings*) {
+  NEXUS_MemoryBlockHandle block = new NEXUS_MemoryBlock;
+  block->data = static_cast<uint8_t*>(::malloc(numBytes));
+  block->size = numBytes;
+  block->locks = 0;
+  if (block->data == nullptr) {
+    delete block;
+    return (nullptr);
+  }
+  g_blockAllocations++;
+  g_liveBlocks++;
+  std::lock_guard<std::mutex> guard(g_lock);
+  g_blocks.insert(block);
+  return (block);
+}
+
+void NEXUS_MemoryBlock_Free(NEXUS_MemoryBlockHandle memoryBlock) {
+  {
+    std::lock_guard<std::mutex> guard(g_lock);
+    g_blocks.erase(memoryBlock);
+  }
+  g_liveBlocks--;
+  ::free(memoryBlock->data);
+  delete memoryBlock;
+}
+
+NEXUS_Error NEXUS_MemoryBlock_Lock(NEXUS_MemoryBlockHandle memoryBlock, void** ppMemory) {
+  memoryBlock->locks++;
+  *ppMemory = memoryBlock->data;
+  return (NEXUS_SUCCESS);
+}
+
+void NEXUS_MemoryBlock_Unlock(NEXUS_MemoryBlockHandle memoryBlock) {
+  memoryBlock->locks--;
+}
+
+NEXUS_MemoryBlockTokenHandle NEXUS_MemoryBlock_CreateToken(NEXUS_MemoryBlockHandle memoryBlock) {
+  g_tokenCount++;
+  return (TokenOf(memoryBlock));
+}
+
+NEXUS_DmaHandle NEXUS_Dma_Open(unsigned, const NEXUS_DmaSettings*) {
+  return (g_dma);
+}
+
+void NEXUS_Dma_Close(NEXUS_DmaHandle) {
+}
+
+void NEXUS_DmaJob_GetDefaultSettings(NEXUS_DmaJobSettings* pSettings) {
+  ::memset(pSettings, 0, sizeof(*pSettings));
+  pSettings->numBlocks = 1;
+}
+
+NEXUS_DmaJobHandle NEXUS_DmaJob_Create(NEXUS_DmaHandle, const NEXUS_DmaJobSettings* pSettings) {
+  NEXUS_DmaJobHandle job = new NEXUS_DmaJob;
+  job->settings = *pSettings;
+  job->state = NEXUS_DmaJobState_eIdle;
+  return (job);
+}
+
+void NEXUS_DmaJob_Destroy(NEXUS_DmaJobHandle handle) {
+  delete handle;
+}
+
+void NEXUS_DmaJob_GetDefaultBlockSettings(NEXUS_DmaJobBlockSettings* pSettings) {
+  ::memset(pSettings, 0, sizeof(*pSettings));
+}
+
+NEXUS_Error NEXUS_DmaJob_ProcessBlocks(NEXUS_DmaJobHandle handle, const NEXUS_DmaJobBlockSettings* pSettings,
+    unsigned nBlocks) {
+  size_t total = 0;
+
+  if ((nBlocks == 0) || (nBlocks > handle->settings.numBlocks) || (handle->state == NEXUS_DmaJobState_eInProgress)) {
+    return (NEXUS_NOT_AVAILABLE);
+  }
+
+  for (unsigned index = 0; index < nBlocks; index++) {
+    ::memcpy(pSettings[index].pDestAddr, pSettings[index].pSrcAddr, pSettings[index].blockSize);
+    total += pSettings[index].blockSize;
+  }
+  g_dmaBlocks += nBlocks;
+  g_dmaBytes += total;
+
+  if ((total < QueuedDmaSize) || (handle->settings.completionCallback.callback == nullptr)) {
+    handle->state = NEXUS_DmaJobState_eComplete;
+    return (NEXUS_SUCCESS);
+  }
+
+  handle->state = NEXUS_DmaJobState_eComplete;
+  handle->settings.completionCallback.callback(handle->settings.completionCallback.context,
+      handle->settings.completionCallback.param);
+  return (NEXUS_DMA_QUEUED);
+}
+
+NEXUS_Error NEXUS_DmaJob_GetStatus(NEXUS_DmaJobHandle handle, NEXUS_DmaJobStatus* pStatus) {
+  pStatus->currentState = handle->state;
+  return (NEXUS_SUCCESS);
+}
+
+void NxClient_GetDefaultJoinSettings(NxClient_JoinSettings* pSettings) {
+  ::memset(pSettings, 0, sizeof(*pSettings));
+}
+
+NEXUS_Error NxClient_Join(const NxClient_JoinSettings*) {
+  return (NEXUS_SUCCESS);
+}
+
+void NxClient_Uninit(void) {
+}
+
+}  // extern "C"
@@ -0,0 +1,45 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include "nexus_memory.h"
+
+#include <stdint.h>
+
+namespace Shim {
+
+// Counters of the Nexus stand-in, so the benchmark can report what the
+// plugin asked of the platform.
+struct NexusCounters {
+  uint64_t memoryAllocations;
+  uint64_t blockAllocations;
+  uint64_t tokens;
+  uint64_t liveBlocks;
+  uint64_t dmaBlocks;
+  uint64_t dmaBytes;
+};
+
+void NexusSnapshot(NexusCounters& counters);
+
+// CPU view of the block a token was created for, nullptr if unknown.
+const uint8_t* NexusResolve(NEXUS_MemoryBlockTokenHandle token, uint32_t* size);
+
+}  // namespace Shim
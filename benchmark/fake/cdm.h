@@ -0,0 +1,158 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Stand-in for the Widevine CE CDM interface, limited to what the plugin
+// uses. Implemented by FakeCdm.cpp for the offline benchmark.
+
+#pragma once
+
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace widevine {
+
+class Cdm {
+public:
+  enum Status {
+    kSuccess = 0,
+    kNeedsDeviceCertificate = 1,
+    kSessionNotFound = 2,
+    kDecryptError = 3,
+    kNoKey = 4,
+    kTypeError = 14,
+    kNotSupported = 15,
+    kInvalidState = 11,
+    kQuotaExceeded = 22,
+    kRangeError = 24,
+    kUnexpectedError = 99,
+    kDeferred = 100
+  };
+
+  enum LogLevel { kSilent = -1, kErrors = 0, kWarnings = 1, kInfo = 2, kVerbose = 3 };
+  enum SecureOutputType { kNoSecureOutput, kOpaqueHandle, kDirectRender };
+  enum SessionType { kTemporary = 0, kPersistentLicense = 1, kPersistentUsageRecord = 2 };
+  enum InitDataType { kCenc = 0, kKeyIds = 1, kWebM = 2 };
+  enum MessageType { kLicenseRequest = 0, kLicenseRenewal = 1, kLicenseRelease = 2, kIndividualizationRequest = 3 };
+  enum KeyStatus { kUsable = 0, kExpired = 1, kOutputRestricted = 2, kStatusPending = 3, kInternalError = 4, kReleased = 5 };
+  enum EncryptionScheme { kClear = 0, kAesCtr = 1, kAesCbc = 2 };
+
+  typedef std::map<std::string, KeyStatus> KeyStatusMap;
+
+  struct Pattern {
+    Pattern() : encrypted_blocks(0), clear_blocks(0) {}
+    uint32_t encrypted_blocks;
+    uint32_t clear_blocks;
+  };
+
+  struct InputBuffer {
+    InputBuffer()
+      : key_id(NULL), key_id_length(0), iv(NULL), iv_length(0), data(NULL), data_length(0)
+      , encryption_scheme(kAesCtr), pattern(), is_video(true), first_subsample(true)
+      , last_subsample(true), block_offset(0) {}
+    const uint8_t* key_id;
+    uint32_t key_id_length;
+    const uint8_t* iv;
+    uint32_t iv_length;
+    const uint8_t* data;
+    uint32_t data_length;
+    EncryptionScheme encryption_scheme;
+    Pattern pattern;
+    bool is_video;
+    bool first_subsample;
+    bool last_subsample;
+    uint32_t block_offset;
+  };
+
+  struct OutputBuffer {
+    OutputBuffer() : data(NULL), data_offset(0), data_length(0), is_secure(false) {}
+    uint8_t* data;
+    uint32_t data_offset;
+    uint32_t data_length;
+    bool is_secure;
+  };
+
+  struct ClientInfo {
+    std::string product_name;
+    std::string company_name;
+    std::string device_name;
+    std::string model_name;
+    std::string arch_name;
+    std::string build_info;
+  };
+
+  class IEventListener {
+  public:
+    virtual ~IEventListener() {}
+    virtual void onMessage(const std::string& session_id, MessageType message_type, const std::string& message) = 0;
+    virtual void onKeyStatusesChange(const std::string& session_id) = 0;
+    virtual void onRemoveComplete(const std::string& session_id) = 0;
+    virtual void onDeferredComplete(const std::string& session_id, Status result) {}
+    virtual void onDirectIndividualizationRequest(const std::string& session_id, const std::string& request) {}
+  };
+
+  class IStorage {
+  public:
+    virtual ~IStorage() {}
+    virtual bool read(const std::string& name, std::string* data) = 0;
+    virtual bool write(const std::string& name, const std::string& data) = 0;
+    virtual bool exists(const std::string& name) = 0;
+    virtual bool remove(const std::string& name) = 0;
+    virtual int32_t size(const std::string& name) = 0;
+    virtual bool list(std::vector<std::string>* file_names) = 0;
+  };
+
+  class IClock {
+  public:
+    virtual ~IClock() {}
+    virtual int64_t now() = 0;
+  };
+
+  class ITimer {
+  public:
+    class IClient {
+    public:
+      virtual ~IClient() {}
+      virtual void onTimerExpired(void* context) = 0;
+    };
+    virtual ~ITimer() {}
+    virtual void setTimeout(int64_t delay_ms, IClient* client, void* context) = 0;
+    virtual void cancel(IClient* client) = 0;
+  };
+
+  static Status initialize(SecureOutputType secure_output_type, const ClientInfo& client_info,
+      IStorage* storage, IClock* clock, ITimer* timer, LogLevel verbosity);
+  static Cdm* create(IEventListener* listener, IStorage* storage, bool privacy_mode);
+
+  virtual ~Cdm() {}
+
+  virtual Status setServiceCertificate(const std::string& certificate) = 0;
+  virtual Status createSession(SessionType session_type, std::string* session_id) = 0;
+  virtual Status generateRequest(const std::string& session_id, InitDataType init_data_type, const std::string& init_data) = 0;
+  virtual Status load(const std::string& session_id) = 0;
+  virtual Status update(const std::string& session_id, const std::string& response) = 0;
+  virtual Status getExpiration(const std::string& session_id, int64_t* expiration) = 0;
+  virtual Status getKeyStatuses(const std::string& session_id, KeyStatusMap* key_statuses) = 0;
+  virtual Status close(const std::string& session_id) = 0;
+  virtual Status remove(const std::string& session_id) = 0;
+  virtual Status decrypt(const InputBuffer& input, const OutputBuffer& output) = 0;
+};
+
+}  // namespace widevine
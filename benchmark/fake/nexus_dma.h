@@ -0,0 +1,85 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Stand-in for the Nexus M2M DMA API, transfers are a memcpy, see
+// NexusShim.cpp.
+
+#pragma once
+
+#include "nexus_memory.h"
+
+#define NEXUS_DMA_QUEUED 0x10B0001
+
+typedef void (*NEXUS_Callback)(void* context, int param);
+
+typedef struct NEXUS_CallbackDesc {
+  NEXUS_Callback callback;
+  void* context;
+  int param;
+} NEXUS_CallbackDesc;
+
+typedef struct NEXUS_Dma* NEXUS_DmaHandle;
+typedef struct NEXUS_DmaJob* NEXUS_DmaJobHandle;
+typedef struct NEXUS_DmaSettings NEXUS_DmaSettings;
+
+typedef struct NEXUS_DmaJobSettings {
+  unsigned numBlocks;
+  NEXUS_CallbackDesc completionCallback;
+} NEXUS_DmaJobSettings;
+
+typedef struct NEXUS_DmaJobBlockSettings {
+  const void* pSrcAddr;
+  void* pDestAddr;
+  size_t blockSize;
+  bool cached;
+  bool resetCrypto;
+  bool scatterGatherCryptoStart;
+  bool scatterGatherCryptoEnd;
+} NEXUS_DmaJobBlockSettings;
+
+typedef enum NEXUS_DmaJobState {
+  NEXUS_DmaJobState_eComplete,
+  NEXUS_DmaJobState_eInProgress,
+  NEXUS_DmaJobState_eFailed,
+  NEXUS_DmaJobState_eIdle
+} NEXUS_DmaJobState;
+
+typedef struct NEXUS_DmaJobStatus {
+  NEXUS_DmaJobState currentState;
+} NEXUS_DmaJobStatus;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+NEXUS_DmaHandle NEXUS_Dma_Open(unsigned index, const NEXUS_DmaSettings* pSettings);
+void NEXUS_Dma_Close(NEXUS_DmaHandle handle);
+
+void NEXUS_DmaJob_GetDefaultSettings(NEXUS_DmaJobSettings* pSettings);
+NEXUS_DmaJobHandle NEXUS_DmaJob_Create(NEXUS_DmaHandle dmaHandle, const NEXUS_DmaJobSettings* pSettings);
+void NEXUS_DmaJob_Destroy(NEXUS_DmaJobHandle handle);
+
+void NEXUS_DmaJob_GetDefaultBlockSettings(NEXUS_DmaJobBlockSettings* pSettings);
+NEXUS_Error NEXUS_DmaJob_ProcessBlocks(NEXUS_DmaJobHandle handle, const NEXUS_DmaJobBlockSettings* pSettings,
+    unsigned nBlocks);
+NEXUS_Error NEXUS_DmaJob_GetStatus(NEXUS_DmaJobHandle handle, NEXUS_DmaJobStatus* pStatus);
+
+#ifdef __cplusplus
+}
+#endif
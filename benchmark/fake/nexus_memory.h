@@ -0,0 +1,63 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Heap backed stand-in for the Nexus memory API, see NexusShim.cpp.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned NEXUS_Error;
+typedef uint64_t NEXUS_Addr;
+
+#define NEXUS_SUCCESS 0
+#define NEXUS_NOT_AVAILABLE 2
+
+typedef struct NEXUS_Heap* NEXUS_HeapHandle;
+typedef struct NEXUS_MemoryBlock* NEXUS_MemoryBlockHandle;
+typedef struct NEXUS_MemoryBlockToken* NEXUS_MemoryBlockTokenHandle;
+typedef struct NEXUS_MemoryAllocationSettings NEXUS_MemoryAllocationSettings;
+typedef struct NEXUS_MemoryBlockAllocationSettings NEXUS_MemoryBlockAllocationSettings;
+
+typedef enum NEXUS_HeapLookupType {
+  NEXUS_HeapLookupType_eMain,
+  NEXUS_HeapLookupType_eCompressedRegion
+} NEXUS_HeapLookupType;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+NEXUS_Error NEXUS_Memory_Allocate(size_t numBytes, const NEXUS_MemoryAllocationSettings* pSettings, void** ppMemory);
+void NEXUS_Memory_Free(void* pMemory);
+
+NEXUS_HeapHandle NEXUS_Heap_Lookup(NEXUS_HeapLookupType lookupType);
+
+NEXUS_MemoryBlockHandle NEXUS_MemoryBlock_Allocate(NEXUS_HeapHandle heap, size_t numBytes, size_t alignment,
+    const NEXUS_MemoryBlockAllocationSettings* pSettings);
+void NEXUS_MemoryBlock_Free(NEXUS_MemoryBlockHandle memoryBlock);
+NEXUS_Error NEXUS_MemoryBlock_Lock(NEXUS_MemoryBlockHandle memoryBlock, void** ppMemory);
+void NEXUS_MemoryBlock_Unlock(NEXUS_MemoryBlockHandle memoryBlock);
+NEXUS_MemoryBlockTokenHandle NEXUS_MemoryBlock_CreateToken(NEXUS_MemoryBlockHandle memoryBlock);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,41 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 RDK Management
+ *
+ * Licensed under the Apache License, Version 2.0 (the License);
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include "nexus_memory.h"
+
+#define NXCLIENT_MAX_NAME 32
+
+typedef struct NxClient_JoinSettings {
+  char name[NXCLIENT_MAX_NAME];
+} NxClient_JoinSettings;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void NxClient_GetDefaultJoinSettings(NxClient_JoinSettings* pSettings);
+NEXUS_Error NxClient_Join(const NxClient_JoinSettings* pSettings);
+void NxClient_Uninit(void);
+
+#ifdef __cplusplus
+}
+#endif